@@ -42,6 +42,7 @@ int		client_attached;
 int		client_connect(char *, int);
 void		client_send_identify(int);
 void		client_send_environ(void);
+void		client_send_command(int, char **);
 void		client_write_server(enum msgtype, void *, size_t);
 void		client_update_event(void);
 void		client_signal(int, short, void *);
@@ -97,9 +98,6 @@ failed:
 int
 client_main(int argc, char **argv, int flags)
 {
-	struct cmd		*cmd;
-	struct cmd_list		*cmdlist;
-	struct msg_command_data	 cmddata;
 	int			 cmdflags, fd;
 	pid_t			 ppid;
 	enum msgtype		 msg;
@@ -110,6 +108,10 @@ client_main(int argc, char **argv, int flags)
 	if (shell_cmd != NULL) {
 		msg = MSG_SHELL;
 		cmdflags = CMD_STARTSERVER;
+	} else if (flags & IDENTIFY_CONTROL) {
+		/* Commands are read by the server from stdin. */
+		msg = MSG_IDENTIFY;
+		cmdflags = CMD_STARTSERVER;
 	} else if (argc == 0) {
 		msg = MSG_COMMAND;
 		cmdflags = CMD_STARTSERVER|CMD_SENDENVIRON|CMD_CANTNEST;
@@ -117,24 +119,14 @@ client_main(int argc, char **argv, int flags)
 		msg = MSG_COMMAND;
 
 		/*
-		 * It sucks parsing the command string twice (in client and
-		 * later in server) but it is necessary to get the start server
-		 * flag.
+		 * Look up the commands to get the start server flag. Their
+		 * arguments are left for the server to check when it parses
+		 * the command line.
 		 */
-		if ((cmdlist = cmd_list_parse(argc, argv, &cause)) == NULL) {
+		if (cmd_list_flags(argc, argv, &cmdflags, &cause) != 0) {
 			log_warnx("%s", cause);
 			return (1);
 		}
-		cmdflags &= ~CMD_STARTSERVER;
-		TAILQ_FOREACH(cmd, &cmdlist->list, qentry) {
-			if (cmd->entry->flags & CMD_STARTSERVER)
-				cmdflags |= CMD_STARTSERVER;
-			if (cmd->entry->flags & CMD_SENDENVIRON)
-				cmdflags |= CMD_SENDENVIRON;
-			if (cmd->entry->flags & CMD_CANTNEST)
-				cmdflags |= CMD_CANTNEST;
-		}
-		cmd_list_free(cmdlist);
 	}
 
 	/*
@@ -174,21 +166,9 @@ client_main(int argc, char **argv, int flags)
 	client_send_identify(flags);
 
 	/* Send first command. */
-	if (msg == MSG_COMMAND) {
-		/* Fill in command line arguments. */
-		cmddata.pid = environ_pid;
-		cmddata.idx = environ_idx;
-
-		/* Prepare command for server. */
-		cmddata.argc = argc;
-		if (cmd_pack_argv(
-		    argc, argv, cmddata.argv, sizeof cmddata.argv) != 0) {
-			log_warnx("command too long");
-			return (1);
-		}
-
-		client_write_server(msg, &cmddata, sizeof cmddata);
-	} else if (msg == MSG_SHELL)
+	if (msg == MSG_COMMAND)
+		client_send_command(argc, argv);
+	else if (msg == MSG_SHELL)
 		client_write_server(msg, NULL, 0);
 
 	/* Set the event and dispatch. */
@@ -225,11 +205,10 @@ client_send_identify(int flags)
 	    strlcpy(data.term, term, sizeof data.term) >= sizeof data.term)
 		*data.term = '\0';
 
-	if ((fd = dup(STDIN_FILENO)) == -1)
-		fatal("dup failed");
-	imsg_compose(&client_ibuf,
-	    MSG_IDENTIFY, PROTOCOL_VERSION, -1, fd, &data, sizeof data);
-
+	/*
+	 * Send stdout and stderr first: a control client's commands may be read
+	 * from stdin as soon as the server has the identify message.
+	 */
 	if ((fd = dup(STDOUT_FILENO)) == -1)
 		fatal("dup failed");
 	imsg_compose(&client_ibuf,
@@ -239,20 +218,80 @@ client_send_identify(int flags)
 		fatal("dup failed");
 	imsg_compose(&client_ibuf,
 	    MSG_STDERR, PROTOCOL_VERSION, -1, fd, NULL, 0);
+
+	if ((fd = dup(STDIN_FILENO)) == -1)
+		fatal("dup failed");
+	imsg_compose(&client_ibuf,
+	    MSG_IDENTIFY, PROTOCOL_VERSION, -1, fd, &data, sizeof data);
 }
 
-/* Forward entire environment to server. */
+/*
+ * Forward entire environment to server, packing as many variables into each
+ * message as fit.
+ */
 void
 client_send_environ(void)
 {
-	struct msg_environ_data	data;
-	char		      **var;
+	char	  **var, buf[MAX_IMSGSIZE - IMSG_HEADER_SIZE];
+	size_t	    len, used;
 
+	used = 0;
 	for (var = environ; *var != NULL; var++) {
-		if (strlcpy(data.var, *var, sizeof data.var) >= sizeof data.var)
+		len = strlen(*var) + 1;
+		if (len > sizeof buf)
 			continue;
-		client_write_server(MSG_ENVIRON, &data, sizeof data);
+		if (used + len > sizeof buf) {
+			client_write_server(MSG_ENVIRON, buf, used);
+			used = 0;
+		}
+		memcpy(buf + used, *var, len);
+		used += len;
 	}
+	if (used != 0)
+		client_write_server(MSG_ENVIRON, buf, used);
+}
+
+/*
+ * Send a command to the server. The packed arguments can be longer than one
+ * message, so all but the last piece are sent first as MSG_COMMANDDATA.
+ */
+void
+client_send_command(int argc, char **argv)
+{
+	struct msg_command_data	 data;
+	struct ibuf		*ibuf;
+	char			*buf, *ptr;
+	size_t			 len, size;
+	int			 i;
+
+	len = 0;
+	for (i = 0; i < argc; i++)
+		len += strlen(argv[i]) + 1;
+	buf = xmalloc(len + 1);
+	cmd_pack_argv(argc, argv, buf, len + 1);
+
+	ptr = buf;
+	size = MAX_IMSGSIZE - IMSG_HEADER_SIZE;
+	while (len > size - sizeof data) {
+		client_write_server(MSG_COMMANDDATA, ptr, size);
+		ptr += size;
+		len -= size;
+	}
+
+	data.pid = environ_pid;
+	data.idx = environ_idx;
+	data.argc = argc;
+
+	ibuf = imsg_create(&client_ibuf,
+	    MSG_COMMAND, PROTOCOL_VERSION, -1, sizeof data + len);
+	if (ibuf == NULL)
+		fatalx("imsg_create failed");
+	imsg_add(ibuf, &data, sizeof data);
+	if (len != 0)
+		imsg_add(ibuf, ptr, len);
+	imsg_close(&client_ibuf, ibuf);
+
+	xfree(buf);
 }
 
 /* Write a message to the server without a file descriptor. */
@@ -44,7 +44,6 @@ cmd_attach_session_exec(struct cmd *self, struct cmd_ctx *ctx)
 	struct client	*c;
 	const char	*update;
 	char		*overrides, *cause;
-	u_int		 i;
 
 	if (RB_EMPTY(&sessions)) {
 		ctx->error(ctx, "no sessions");
@@ -63,9 +62,8 @@ cmd_attach_session_exec(struct cmd *self, struct cmd_ctx *ctx)
 			 * Can't use server_write_session in case attaching to
 			 * the same session as currently attached to.
 			 */
-			for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-				c = ARRAY_ITEM(&clients, i);
-				if (c == NULL || c->session != s)
+			TAILQ_FOREACH(c, &clients, entry) {
+				if (c->session != s)
 					continue;
 				if (c == ctx->curclient)
 					continue;
@@ -90,7 +90,6 @@ cmd_bind_key_table(struct cmd *self, struct cmd_ctx *ctx, int key)
 	struct args			*args = self->args;
 	const char			*tablename;
 	const struct mode_key_table	*mtab;
-	struct mode_key_binding		*mbind, mtmp;
 	enum mode_key_cmd		 cmd;
 
 	tablename = args_get(args, 't');
@@ -105,16 +104,6 @@ cmd_bind_key_table(struct cmd *self, struct cmd_ctx *ctx, int key)
 		return (-1);
 	}
 
-	mtmp.key = key;
-	mtmp.mode = !!args_has(args, 'c');
-	if ((mbind = SPLAY_FIND(mode_key_tree, mtab->tree, &mtmp)) != NULL) {
-		mbind->cmd = cmd;
-		return (0);
-	}
-	mbind = xmalloc(sizeof *mbind);
-	mbind->key = mtmp.key;
-	mbind->mode = mtmp.mode;
-	mbind->cmd = cmd;
-	SPLAY_INSERT(mode_key_tree, mtab->tree, mbind);
+	mode_key_add(mtab, key, !!args_has(args, 'c'), cmd);
 	return (0);
 }
@@ -67,6 +67,7 @@ cmd_break_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 			if (w->active == NULL)
 				w->active = TAILQ_NEXT(wp, entry);
 		}
+		queue_window_name(w);
 	} else if (wp == w->last)
 		w->last = NULL;
 	layout_close_pane(wp);
@@ -17,22 +17,54 @@
  */
 
 #include <sys/types.h>
+#include <sys/stat.h>
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "tmux.h"
 
 /*
- * Write the entire contents of a pane to a buffer.
+ * Write the entire contents of a pane to a buffer, or to a file or stdout.
  */
 
+/* Lines converted each time round the event loop when writing to a file. */
+#define CAPTURE_PANE_LINES 1024
+
+struct cmd_capture_pane_data {
+	u_int		 pane;
+	u_int		 hcollected;
+
+	u_int		 next;		/* next line to write */
+	u_int		 last;
+
+	char		*line;
+	size_t		 linesize;
+
+	struct client	*c;
+	int		 fd;
+	struct evbuffer	*out;
+	struct event	 timer;
+};
+
 int	cmd_capture_pane_exec(struct cmd *, struct cmd_ctx *);
 
+int	cmd_capture_pane_stream(
+	    struct cmd *, struct cmd_ctx *, struct window_pane *, u_int, u_int);
+int	cmd_capture_pane_lines(
+	    struct cmd_capture_pane_data *, struct evbuffer *);
+void	cmd_capture_pane_stdout(struct client *, int, void *);
+void	cmd_capture_pane_timer(int, short, void *);
+void	cmd_capture_pane_free(struct cmd_capture_pane_data *, const char *);
+
 const struct cmd_entry cmd_capture_pane_entry = {
 	"capture-pane", "capturep",
-	"b:E:S:t:", 0, 0,
-	"[-b buffer-index] [-E end-line] [-S start-line] [-t target-pane]",
+	"ab:E:S:t:", 0, 1,
+	"[-a] [-b buffer-index] [-E end-line] [-S start-line] [-t target-pane] "
+	"[path]",
 	0,
 	NULL,
 	NULL,
@@ -49,17 +81,14 @@ cmd_capture_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 	struct grid		*gd;
 	int			 buffer, n;
 	u_int			 i, limit, top, bottom, tmp;
-	size_t         		 len, linelen;
+	size_t         		 len, size, linelen, linesize;
 
 	if (cmd_find_pane(ctx, args_get(args, 't'), NULL, &wp) == NULL)
 		return (-1);
 	s = &wp->base;
 	gd = s->grid;
 
-	buf = NULL;
-	len = 0;
-
-	n = args_strtonum(args, 'S', SHRT_MIN, SHRT_MAX, &cause);
+	n = args_strtonum(args, 'S', -INT_MAX, INT_MAX, &cause);
 	if (cause != NULL) {
 		top = gd->hsize;
 		xfree(cause);
@@ -70,7 +99,7 @@ cmd_capture_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 	if (top > gd->hsize + gd->sy - 1)
 		top = gd->hsize + gd->sy - 1;
 
-	n = args_strtonum(args, 'E', SHRT_MIN, SHRT_MAX, &cause);
+	n = args_strtonum(args, 'E', -INT_MAX, INT_MAX, &cause);
 	if (cause != NULL) {
 		bottom = gd->hsize + gd->sy - 1;
 		xfree(cause);
@@ -87,17 +116,30 @@ cmd_capture_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 		top = tmp;
 	}
 
-	for (i = top; i <= bottom; i++) {
-	       line = grid_string_cells(s->grid, 0, i, screen_size_x(s));
-	       linelen = strlen(line);
+	if (args->argc != 0)
+		return (cmd_capture_pane_stream(self, ctx, wp, top, bottom));
+
+	buf = NULL;
+	len = size = 0;
 
-	       buf = xrealloc(buf, 1, len + linelen + 1);
-	       memcpy(buf + len, line, linelen);
-	       len += linelen;
-	       buf[len++] = '\n';
+	line = NULL;
+	linesize = 0;
+	for (i = top; i <= bottom; i++) {
+		linelen = grid_string_cells_buffer(
+		    gd, 0, i, screen_size_x(s), &line, &linesize);
 
-	       xfree(line);
+		if (len + linelen + 1 > size) {
+			if (size == 0)
+				size = BUFSIZ;
+			while (size < len + linelen + 1)
+				size *= 2;
+			buf = xrealloc(buf, 1, size);
+		}
+		memcpy(buf + len, line, linelen);
+		len += linelen;
+		buf[len++] = '\n';
 	}
+	xfree(line);
 
 	limit = options_get_number(&global_options, "buffer-limit");
 
@@ -110,6 +152,7 @@ cmd_capture_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 	if (cause != NULL) {
 		ctx->error(ctx, "buffer %s", cause);
 		xfree(cause);
+		xfree(buf);
 		return (-1);
 	}
 
@@ -121,3 +164,199 @@ cmd_capture_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 
 	return (0);
 }
+
+/*
+ * Start writing lines top to bottom of a pane to a file or to stdout. The
+ * lines are converted straight from the grid a piece at a time, so no copy of
+ * the whole range is made and the server doesn't stop while it is written.
+ */
+int
+cmd_capture_pane_stream(struct cmd *self, struct cmd_ctx *ctx,
+    struct window_pane *wp, u_int top, u_int bottom)
+{
+	struct args			*args = self->args;
+	struct client			*c = ctx->cmdclient;
+	struct cmd_capture_pane_data	*cdata;
+	struct timeval			 tv;
+	const char			*path;
+	int				 fd, flags;
+	mode_t				 mask;
+
+	path = args->argv[0];
+	if (strcmp(path, "-") == 0) {
+		if (c == NULL || c->stdout_fd == -1) {
+			ctx->error(ctx, "%s: can't write to stdout", path);
+			return (-1);
+		}
+		if (c->stdout_callback != NULL) {
+			ctx->error(ctx, "%s: stdout is busy", path);
+			return (-1);
+		}
+		fd = -1;
+	} else {
+		flags = O_WRONLY|O_CREAT;
+		if (args_has(args, 'a'))
+			flags |= O_APPEND;
+		else
+			flags |= O_TRUNC;
+
+		mask = umask(S_IRWXG | S_IRWXO);
+		fd = open(path, flags, 0666);
+		umask(mask);
+		if (fd == -1) {
+			ctx->error(ctx, "%s: %s", path, strerror(errno));
+			return (-1);
+		}
+	}
+
+	cdata = xcalloc(1, sizeof *cdata);
+	cdata->pane = wp->id;
+	cdata->hcollected = wp->base.grid->hcollected;
+	cdata->next = top;
+	cdata->last = bottom;
+
+	cdata->line = NULL;
+	cdata->linesize = 0;
+
+	cdata->c = c;
+	if (c != NULL)
+		c->references++;
+	cdata->fd = fd;
+
+	if (fd == -1) {
+		/* Each piece is written once the last has been. */
+		c->stdout_data = cdata;
+		c->stdout_callback = cmd_capture_pane_stdout;
+		cmd_capture_pane_stdout(c, 0, cdata);
+	} else {
+		cdata->out = evbuffer_new();
+		if (cdata->out == NULL)
+			fatalx("evbuffer_new failed");
+
+		evtimer_set(&cdata->timer, cmd_capture_pane_timer, cdata);
+		memset(&tv, 0, sizeof tv);
+		evtimer_add(&cdata->timer, &tv);
+	}
+
+	/* Keep the client until everything is written. */
+	return (c != NULL);
+}
+
+/*
+ * Convert the next lines into a buffer. Returns 1 when there are no more
+ * lines, either because the last has been reached or the pane has gone.
+ */
+int
+cmd_capture_pane_lines(
+    struct cmd_capture_pane_data *cdata, struct evbuffer *out)
+{
+	struct window_pane	*wp;
+	struct grid		*gd;
+	u_int			 n, lines;
+	size_t			 len;
+
+	if ((wp = window_pane_find_by_id(cdata->pane)) == NULL)
+		return (1);
+	gd = wp->base.grid;
+
+	/*
+	 * If lines have been removed from the top of the history since the
+	 * last time, the lines left have moved up.
+	 */
+	n = gd->hcollected - cdata->hcollected;
+	cdata->hcollected = gd->hcollected;
+	if (n > cdata->last)
+		return (1);
+	cdata->last -= n;
+	if (n > cdata->next)
+		cdata->next = 0;
+	else
+		cdata->next -= n;
+	if (cdata->last > gd->hsize + gd->sy - 1)
+		cdata->last = gd->hsize + gd->sy - 1;
+
+	for (lines = 0; lines < CAPTURE_PANE_LINES; lines++) {
+		if (cdata->next > cdata->last)
+			break;
+		len = grid_string_cells_buffer(gd,
+		    0, cdata->next++, gd->sx, &cdata->line, &cdata->linesize);
+		evbuffer_add(out, cdata->line, len);
+		evbuffer_add(out, "\n", 1);
+	}
+
+	return (cdata->next > cdata->last);
+}
+
+/* Client stdout has been written or closed, write the next lines. */
+void
+cmd_capture_pane_stdout(struct client *c, int closed, void *data)
+{
+	struct cmd_capture_pane_data	*cdata = data;
+
+	if (closed) {
+		cmd_capture_pane_free(cdata, NULL);
+		return;
+	}
+
+	if (cmd_capture_pane_lines(cdata, c->stdout_event->output))
+		cmd_capture_pane_free(cdata, NULL);
+	bufferevent_enable(c->stdout_event, EV_WRITE);
+}
+
+/* Timer for writing to a file: write the next lines. */
+/* ARGSUSED */
+void
+cmd_capture_pane_timer(unused int fd, unused short events, void *data)
+{
+	struct cmd_capture_pane_data	*cdata = data;
+	struct timeval			 tv;
+	int				 done;
+
+	done = cmd_capture_pane_lines(cdata, cdata->out);
+	while (EVBUFFER_LENGTH(cdata->out) != 0) {
+		if (evbuffer_write(cdata->out, cdata->fd) <= 0) {
+			cmd_capture_pane_free(cdata, strerror(errno));
+			return;
+		}
+	}
+
+	if (done) {
+		cmd_capture_pane_free(cdata, NULL);
+		return;
+	}
+
+	memset(&tv, 0, sizeof tv);
+	evtimer_add(&cdata->timer, &tv);
+}
+
+/* Finished writing, report any error and let the client exit. */
+void
+cmd_capture_pane_free(struct cmd_capture_pane_data *cdata, const char *cause)
+{
+	struct client	*c = cdata->c;
+
+	if (c != NULL) {
+		if (c->stdout_callback == cmd_capture_pane_stdout) {
+			c->stdout_callback = NULL;
+			c->stdout_data = NULL;
+		}
+
+		if (cause != NULL && !(c->flags & CLIENT_DEAD)) {
+			evbuffer_add_printf(c->stderr_event->output,
+			    "capture-pane: %s\n", cause);
+			bufferevent_enable(c->stderr_event, EV_WRITE);
+			c->retcode = 1;
+		}
+
+		c->flags |= CLIENT_EXIT;
+		c->references--;
+	}
+
+	if (cdata->fd != -1)
+		close(cdata->fd);
+	if (cdata->out != NULL)
+		evbuffer_free(cdata->out);
+	if (cdata->line != NULL)
+		xfree(cdata->line);
+	xfree(cdata);
+}
@@ -54,7 +54,7 @@ cmd_choose_buffer_exec(struct cmd *self, struct cmd_ctx *ctx)
 	struct winlink			*wl;
 	struct paste_buffer		*pb;
 	u_int				 idx;
-	char				*tmp;
+	const char			*tmp;
 
 	if (ctx->curclient == NULL) {
 		ctx->error(ctx, "must be run interactively");
@@ -75,7 +75,6 @@ cmd_choose_buffer_exec(struct cmd *self, struct cmd_ctx *ctx)
 		tmp = paste_print(pb, 50);
 		window_choose_add(wl->window->active, idx - 1,
 		    "%u: %zu bytes: \"%s\"", idx - 1, pb->size, tmp);
-		xfree(tmp);
 	}
 
 	cdata = xmalloc(sizeof *cdata);
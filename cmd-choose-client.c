@@ -53,7 +53,7 @@ cmd_choose_client_exec(struct cmd *self, struct cmd_ctx *ctx)
 	struct cmd_choose_client_data	*cdata;
 	struct winlink			*wl;
 	struct client			*c;
-	u_int			 	 i, idx, cur;
+	u_int			 	 idx, cur;
 
 	if (ctx->curclient == NULL) {
 		ctx->error(ctx, "must be run interactively");
@@ -67,15 +67,13 @@ cmd_choose_client_exec(struct cmd *self, struct cmd_ctx *ctx)
 		return (0);
 
 	cur = idx = 0;
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
 			continue;
 		if (c == ctx->curclient)
 			cur = idx;
-		idx++;
 
-		window_choose_add(wl->window->active, i,
+		window_choose_add(wl->window->active, idx++,
 		    "%s: %s [%ux%u %s]%s", c->tty.path,
 		    c->session->name, c->tty.sx, c->tty.sy,
 		    c->tty.termname, c->tty.flags & TTY_UTF8 ? " (utf8)" : "");
@@ -109,10 +107,14 @@ cmd_choose_client_callback(void *data, int idx)
 	if (cdata->client->flags & CLIENT_DEAD)
 		return;
 
-	if ((u_int) idx > ARRAY_LENGTH(&clients) - 1)
-		return;
-	c = ARRAY_ITEM(&clients, idx);
-	if (c == NULL || c->session == NULL)
+	/* Clients are numbered in list order, skipping unattached ones. */
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
+			continue;
+		if (idx-- == 0)
+			break;
+	}
+	if (c == NULL)
 		return;
 	template = cmd_template_replace(cdata->template, c->tty.path, 1);
 
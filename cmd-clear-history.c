@@ -48,7 +48,12 @@ cmd_clear_history_exec(struct cmd *self, struct cmd_ctx *ctx)
 	gd = wp->base.grid;
 
 	grid_move_lines(gd, 0, gd->hsize, gd->sy);
+	gd->hcollected += gd->hsize;
 	gd->hsize = 0;
+	if (gd->index != NULL)
+		grid_index_collect(gd);
+	if (wp->mode == &window_copy_mode)
+		window_copy_backing_changed(wp);
 
 	return (0);
 }
@@ -43,7 +43,6 @@ cmd_detach_client_exec(struct cmd *self, struct cmd_ctx *ctx)
 	struct client	*c;
 	struct session 	*s;
 	enum msgtype     msgtype;
-	u_int 		 i;
 
 	if (args_has(args, 'P'))
 		msgtype = MSG_DETACHKILL;
@@ -55,9 +54,8 @@ cmd_detach_client_exec(struct cmd *self, struct cmd_ctx *ctx)
 		if (s == NULL)
 			return (-1);
 
-		for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-			c = ARRAY_ITEM(&clients, i);
-			if (c != NULL && c->session == s)
+		TAILQ_FOREACH(c, &clients, entry) {
+			if (c->session == s)
 				server_write_client(c, msgtype, NULL, 0);
 		}
 	} else {
@@ -18,121 +18,296 @@
 
 #include <sys/types.h>
 
-#include <fnmatch.h>
+#include <limits.h>
+#include <stdarg.h>
 #include <string.h>
 
 #include "tmux.h"
 
 /*
  * Find window containing text.
+ *
+ * Searching the contents of many panes may take a while, so it is done a
+ * slice at a time from a timer rather than all at once.
  */
 
+/* Number of lines looked at before giving up to the event loop. */
+#define CMD_FIND_WINDOW_LINES 2000
+
+struct cmd_find_window_data {
+	struct session	*session;
+};
+
+struct cmd_find_window_search {
+	struct cmd_ctx		 ctx;
+	struct session		*session;
+	int			 target;	/* index of target window */
+
+	char			*str;
+	struct window_match	 match;
+	int			 contents;
+
+	int			 idx;		/* window being searched */
+	u_int			 number;	/* pane number in window */
+	int			 id;		/* pane id, or -1 if not started */
+	u_int			 line;		/* absolute history line */
+
+	ARRAY_DECL(, int)	 list_idx;
+	ARRAY_DECL(, char *)	 list_ctx;
+
+	struct event		 timer;
+};
+
 int	cmd_find_window_exec(struct cmd *, struct cmd_ctx *);
 
+int	cmd_find_window_run(struct cmd_find_window_search *);
+int	cmd_find_window_pane(struct cmd_find_window_search *,
+	    struct winlink *, struct window_pane *, u_int *);
+void printflike3 cmd_find_window_add(struct cmd_find_window_search *,
+	    struct winlink *, const char *, ...);
+int	cmd_find_window_finish(struct cmd_find_window_search *);
+void	cmd_find_window_timer(int, short, void *);
+void	cmd_find_window_end(struct cmd_find_window_search *);
+
 void	cmd_find_window_callback(void *, int);
 void	cmd_find_window_free(void *);
 
 const struct cmd_entry cmd_find_window_entry = {
 	"find-window", "findw",
-	"t:", 1, 1,
-	CMD_TARGET_WINDOW_USAGE " match-string",
+	"Ct:", 1, 1,
+	"[-C] " CMD_TARGET_WINDOW_USAGE " match-string",
 	0,
 	NULL,
 	NULL,
 	cmd_find_window_exec
 };
 
-struct cmd_find_window_data {
-	struct session	*session;
-};
-
 int
 cmd_find_window_exec(struct cmd *self, struct cmd_ctx *ctx)
 {
 	struct args			*args = self->args;
-	struct cmd_find_window_data	*cdata;
-	struct session			*s;
-	struct winlink			*wl, *wm;
-	struct window			*w;
-	struct window_pane		*wp;
-	ARRAY_DECL(, u_int)	 	 list_idx;
-	ARRAY_DECL(, char *)	 	 list_ctx;
-	char				*str, *sres, *sctx, *searchstr;
-	u_int				 i, line;
+	struct cmd_find_window_search	*fs;
+	struct winlink			*wl;
+	struct timeval			 tv;
+	int				 retval;
 
 	if (ctx->curclient == NULL) {
 		ctx->error(ctx, "must be run interactively");
 		return (-1);
 	}
-	s = ctx->curclient->session;
 
 	if ((wl = cmd_find_window(ctx, args_get(args, 't'), NULL)) == NULL)
 		return (-1);
 
-	str = args->argv[0];
+	fs = xcalloc(1, sizeof *fs);
+	memcpy(&fs->ctx, ctx, sizeof fs->ctx);
+	fs->session = ctx->curclient->session;
+	fs->target = wl->idx;
 
-	ARRAY_INIT(&list_idx);
-	ARRAY_INIT(&list_ctx);
+	fs->str = xstrdup(args->argv[0]);
+	window_match_init(&fs->match, fs->str);
+	fs->contents = args_has(args, 'C');
 
-	xasprintf(&searchstr, "*%s*", str);
-	RB_FOREACH(wm, winlinks, &s->windows) {
-		i = 0;
-		TAILQ_FOREACH(wp, &wm->window->panes, entry) {
-			i++;
-
-			if (fnmatch(searchstr, wm->window->name, 0) == 0)
-				sctx = xstrdup("");
-			else {
-				sres = window_pane_search(wp, str, &line);
-				if (sres == NULL &&
-				    fnmatch(searchstr, wp->base.title, 0) != 0)
-					continue;
-
-				if (sres == NULL) {
-					xasprintf(&sctx,
-					    "pane %u title: \"%s\"", i - 1,
-					    wp->base.title);
-				} else {
-					xasprintf(&sctx,
-					    "pane %u line %u: \"%s\"", i - 1,
-					    line + 1, sres);
-					xfree(sres);
-				}
+	fs->idx = 0;
+	fs->number = 0;
+	fs->id = -1;
+
+	ARRAY_INIT(&fs->list_idx);
+	ARRAY_INIT(&fs->list_ctx);
+
+	/* Most searches are over quickly, so do the first part now. */
+	if (cmd_find_window_run(fs) != 0) {
+		retval = cmd_find_window_finish(fs);
+		cmd_find_window_end(fs);
+		return (retval);
+	}
+
+	fs->session->references++;
+	if (ctx->cmdclient != NULL)
+		ctx->cmdclient->references++;
+	ctx->curclient->references++;
+
+	evtimer_set(&fs->timer, cmd_find_window_timer, fs);
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+	evtimer_add(&fs->timer, &tv);
+
+	return (1);	/* don't let client exit */
+}
+
+/* Search panes until done or out of lines. Returns 1 when finished. */
+int
+cmd_find_window_run(struct cmd_find_window_search *fs)
+{
+	struct winlink		*wl, *wm;
+	struct window_pane	*wp;
+	u_int			 left, i;
+
+	left = CMD_FIND_WINDOW_LINES;
+	for (;;) {
+		/* Windows may have come or gone, so find the next by index. */
+		wl = NULL;
+		RB_FOREACH(wm, winlinks, &fs->session->windows) {
+			if (wm->idx >= fs->idx) {
+				wl = wm;
+				break;
 			}
+		}
+		if (wl == NULL)
+			return (1);
+		if (wl->idx != fs->idx) {
+			fs->idx = wl->idx;
+			fs->number = 0;
+			fs->id = -1;
+		}
+
+		i = 0;
+		TAILQ_FOREACH(wp, &wl->window->panes, entry) {
+			if (i++ == fs->number)
+				break;
+		}
+		if (wp == NULL) {
+			if (fs->idx == INT_MAX)
+				return (1);
+			fs->idx++;
+			fs->number = 0;
+			fs->id = -1;
+			continue;
+		}
+
+		/* Start again if the pane was killed while being searched. */
+		if (fs->id != -1 && (u_int) fs->id != wp->id)
+			fs->id = -1;
+
+		if (cmd_find_window_pane(fs, wl, wp, &left) == 0)
+			return (0);
+		fs->number++;
+		fs->id = -1;
+	}
+}
+
+/*
+ * Search one pane, continuing from where the last search of it stopped.
+ * Returns 1 if the pane has been finished with, 0 if it is out of lines.
+ */
+int
+cmd_find_window_pane(struct cmd_find_window_search *fs,
+    struct winlink *wl, struct window_pane *wp, u_int *left)
+{
+	struct window_match	*wm = &fs->match;
+	struct grid		*gd = wp->base.grid;
+	char			*sres;
+	u_int			 line, py;
+
+	if (fs->id == -1) {
+		fs->id = wp->id;
+		fs->line = gd->hcollected + gd->hsize;
+
+		if (!fs->contents && window_match_string(wm, wl->window->name)) {
+			cmd_find_window_add(fs, wl, "%s", "");
+			return (1);
+		}
 
-			ARRAY_ADD(&list_idx, wm->idx);
-			ARRAY_ADD(&list_ctx, sctx);
+		line = screen_size_y(&wp->base);
+		*left -= line < *left ? line : *left;
+		sres = window_pane_search(wp, wm, 0, line, &line);
+		if (sres != NULL) {
+			cmd_find_window_add(fs, wl, "pane %u line %u: \"%s\"",
+			    fs->number, line + 1, sres);
+			xfree(sres);
+			return (1);
 		}
+
+		if (!fs->contents) {
+			if (window_match_string(wm, wp->base.title)) {
+				cmd_find_window_add(fs, wl,
+				    "pane %u title: \"%s\"", fs->number,
+				    wp->base.title);
+			}
+			return (1);
+		}
+	}
+
+	/* Lines may have been collected since the last part of the search. */
+	if (fs->line <= gd->hcollected)
+		return (1);
+	py = fs->line - gd->hcollected;
+
+	sres = window_pane_search_history(wp, wm, &py, left);
+	fs->line = gd->hcollected + py;
+	if (sres != NULL) {
+		cmd_find_window_add(fs, wl, "pane %u line -%u: \"%s\"",
+		    fs->number, gd->hsize - py, sres);
+		xfree(sres);
+		return (1);
 	}
-	xfree(searchstr);
+	return (py == 0);
+}
+
+/* Add a match to the list. */
+void
+cmd_find_window_add(struct cmd_find_window_search *fs,
+    struct winlink *wl, const char *fmt, ...)
+{
+	va_list	 ap;
+	char	*sctx;
+
+	va_start(ap, fmt);
+	xvasprintf(&sctx, fmt, ap);
+	va_end(ap);
 
-	if (ARRAY_LENGTH(&list_idx) == 0) {
-		ctx->error(ctx, "no windows matching: %s", str);
-		ARRAY_FREE(&list_idx);
-		ARRAY_FREE(&list_ctx);
+	ARRAY_ADD(&fs->list_idx, wl->idx);
+	ARRAY_ADD(&fs->list_ctx, sctx);
+}
+
+/* Search finished, show the matches. */
+int
+cmd_find_window_finish(struct cmd_find_window_search *fs)
+{
+	struct cmd_ctx			*ctx = &fs->ctx;
+	struct session			*s = fs->session;
+	struct cmd_find_window_data	*cdata;
+	struct winlink			*wl, *wm;
+	struct window			*w;
+	u_int				 i;
+
+	/* Drop any windows killed since they were found. */
+	for (i = 0; i < ARRAY_LENGTH(&fs->list_idx); i++) {
+		if (winlink_find_by_index(&s->windows,
+		    ARRAY_ITEM(&fs->list_idx, i)) != NULL)
+			continue;
+		xfree(ARRAY_ITEM(&fs->list_ctx, i));
+		ARRAY_REMOVE(&fs->list_idx, i);
+		ARRAY_REMOVE(&fs->list_ctx, i);
+		i--;
+	}
+
+	if (ARRAY_LENGTH(&fs->list_idx) == 0) {
+		ctx->error(ctx, "no windows matching: %s", fs->str);
 		return (-1);
 	}
 
-	if (ARRAY_LENGTH(&list_idx) == 1) {
-		if (session_select(s, ARRAY_FIRST(&list_idx)) == 0)
+	if (ARRAY_LENGTH(&fs->list_idx) == 1) {
+		if (session_select(s, ARRAY_FIRST(&fs->list_idx)) == 0)
 			server_redraw_session(s);
 		recalculate_sizes();
-		goto out;
+		return (0);
 	}
 
+	if ((wl = winlink_find_by_index(&s->windows, fs->target)) == NULL)
+		wl = s->curw;
 	if (window_pane_set_mode(wl->window->active, &window_choose_mode) != 0)
-		goto out;
+		return (0);
 
-	for (i = 0; i < ARRAY_LENGTH(&list_idx); i++) {
+	for (i = 0; i < ARRAY_LENGTH(&fs->list_idx); i++) {
 		wm = winlink_find_by_index(
-		    &s->windows, ARRAY_ITEM(&list_idx, i));
+		    &s->windows, ARRAY_ITEM(&fs->list_idx, i));
 		w = wm->window;
 
-		sctx = ARRAY_ITEM(&list_ctx, i);
 		window_choose_add(wl->window->active,
 		    wm->idx, "%3d: %s [%ux%u] (%u panes) %s", wm->idx, w->name,
-		    w->sx, w->sy, window_count_panes(w), sctx);
-		xfree(sctx);
+		    w->sx, w->sy, window_count_panes(w),
+		    ARRAY_ITEM(&fs->list_ctx, i));
 	}
 
 	cdata = xmalloc(sizeof *cdata);
@@ -142,11 +317,55 @@ cmd_find_window_exec(struct cmd *self, struct cmd_ctx *ctx)
 	window_choose_ready(wl->window->active,
 	    0, cmd_find_window_callback, cmd_find_window_free, cdata);
 
+	return (0);
+}
+
+/* Timer to carry on searching. */
+/* ARGSUSED */
+void
+cmd_find_window_timer(unused int fd, unused short events, void *arg)
+{
+	struct cmd_find_window_search	*fs = arg;
+	struct cmd_ctx			*ctx = &fs->ctx;
+	struct timeval			 tv;
+
+	if (!session_alive(fs->session) ||
+	    (ctx->cmdclient != NULL && ctx->cmdclient->flags & CLIENT_DEAD) ||
+	    ctx->curclient->flags & CLIENT_DEAD)
+		goto out;
+
+	if (cmd_find_window_run(fs) == 0) {
+		tv.tv_sec = 0;
+		tv.tv_usec = 0;
+		evtimer_add(&fs->timer, &tv);
+		return;
+	}
+	cmd_find_window_finish(fs);
+
 out:
-	ARRAY_FREE(&list_idx);
-	ARRAY_FREE(&list_ctx);
+	fs->session->references--;
+	if (ctx->cmdclient != NULL) {
+		ctx->cmdclient->references--;
+		ctx->cmdclient->flags |= CLIENT_EXIT;
+	}
+	ctx->curclient->references--;
+	cmd_find_window_end(fs);
+}
 
-	return (0);
+/* Free a search. */
+void
+cmd_find_window_end(struct cmd_find_window_search *fs)
+{
+	u_int	i;
+
+	for (i = 0; i < ARRAY_LENGTH(&fs->list_ctx); i++)
+		xfree(ARRAY_ITEM(&fs->list_ctx, i));
+	ARRAY_FREE(&fs->list_idx);
+	ARRAY_FREE(&fs->list_ctx);
+
+	window_match_free(&fs->match);
+	xfree(fs->str);
+	xfree(fs);
 }
 
 void
@@ -119,6 +119,7 @@ cmd_join_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
 		src_w->active = TAILQ_PREV(src_wp, window_panes, entry);
 		if (src_w->active == NULL)
 			src_w->active = TAILQ_NEXT(src_wp, entry);
+		queue_window_name(src_w);
 	}
 	TAILQ_REMOVE(&src_w->panes, src_wp, entry);
 
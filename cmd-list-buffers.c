@@ -44,14 +44,13 @@ cmd_list_buffers_exec(unused struct cmd *self, struct cmd_ctx *ctx)
 {
 	struct paste_buffer	*pb;
 	u_int			 idx;
-	char			*tmp;
+	const char		*tmp;
 
 	idx = 0;
 	while ((pb = paste_walk_stack(&global_buffers, &idx)) != NULL) {
 		tmp = paste_print(pb, 50);
 		ctx->print(ctx,
 		    "%u: %zu bytes: \"%s\"", idx - 1, pb->size, tmp);
-		xfree(tmp);
 	}
 
 	return (0);
@@ -46,7 +46,6 @@ cmd_list_clients_exec(struct cmd *self, struct cmd_ctx *ctx)
 	struct args 	*args = self->args;
 	struct client	*c;
 	struct session  *s;
-	u_int		 i;
 	const char	*s_utf8;
 
 	if (args_has(args, 't')) {
@@ -56,9 +55,8 @@ cmd_list_clients_exec(struct cmd *self, struct cmd_ctx *ctx)
 	} else
 		s = NULL;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
 			continue;
 
 		if (c->tty.flags & TTY_UTF8)
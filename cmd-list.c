@@ -78,6 +78,47 @@ bad:
 	return (NULL);
 }
 
+/*
+ * Work out the flags of the commands in a command line from their names,
+ * without parsing their arguments. The server checks those when it parses
+ * the command line itself.
+ */
+int
+cmd_list_flags(int argc, char **argv, int *flags, char **cause)
+{
+	const struct cmd_entry	*entry;
+	char			*name;
+	size_t			 arglen;
+	int			 i, start, split;
+
+	*flags = 0;
+	start = 0;
+	for (i = 0; i < argc; i++) {
+		arglen = strlen(argv[i]);
+		split = arglen != 0 && argv[i][arglen - 1] == ';' &&
+		    (arglen == 1 || argv[i][arglen - 2] != '\\');
+
+		if (i == start) {
+			if (split && arglen == 1) {
+				xasprintf(cause, "no command");
+				return (-1);
+			}
+			name = xstrdup(argv[i]);
+			if (split)
+				name[arglen - 1] = '\0';
+			entry = cmd_lookup(name, cause);
+			xfree(name);
+			if (entry == NULL)
+				return (-1);
+			*flags |= entry->flags;
+		}
+
+		if (split)
+			start = i + 1;
+	}
+	return (0);
+}
+
 int
 cmd_list_exec(struct cmd_list *cmdlist, struct cmd_ctx *ctx)
 {
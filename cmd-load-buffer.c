@@ -17,9 +17,11 @@
  */
 
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <errno.h>
-#include <stdio.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -28,15 +30,44 @@
 
 /*
  * Loads a session paste buffer from a file.
+ *
+ * The file is read a piece at a time from the event loop, straight into the
+ * new buffer, so loading a large file from a slow file system doesn't stop
+ * the server.
  */
 
+struct cmd_load_buffer_data {
+	int			 buffer;
+
+	char			*data;
+	size_t			 size;
+	size_t			 space;
+	size_t			 total;		/* file size or 0 */
+
+	char			*path;
+	int			 fd;
+	struct event		 timer;
+
+	struct client		*c;		/* client waiting for exit */
+	struct client		*report;	/* client shown progress */
+	time_t			 started;
+	time_t			 reported;
+};
+
 int	cmd_load_buffer_exec(struct cmd *, struct cmd_ctx *);
-void	cmd_load_buffer_callback(struct client *, void *);
+
+int	cmd_load_buffer_map(
+	    struct cmd_ctx *, const char *, int, struct stat *, int);
+int	cmd_load_buffer_grow(struct cmd_load_buffer_data *, size_t);
+void	cmd_load_buffer_stdin(struct client *, int, void *);
+void	cmd_load_buffer_timer(int, short, void *);
+void	cmd_load_buffer_progress(struct cmd_load_buffer_data *);
+void	cmd_load_buffer_free(struct cmd_load_buffer_data *, const char *);
 
 const struct cmd_entry cmd_load_buffer_entry = {
 	"load-buffer", "loadb",
-	"b:", 1, 1,
-	CMD_BUFFER_USAGE " path",
+	"b:m", 1, 1,
+	"[-m] " CMD_BUFFER_USAGE " path",
 	0,
 	NULL,
 	NULL,
@@ -46,15 +77,14 @@ const struct cmd_entry cmd_load_buffer_entry = {
 int
 cmd_load_buffer_exec(struct cmd *self, struct cmd_ctx *ctx)
 {
-	struct args	*args = self->args;
-	struct client	*c = ctx->cmdclient;
-	FILE		*f;
-	const char	*path;
-	char		*pdata, *new_pdata, *cause;
-	size_t		 psize;
-	u_int		 limit;
-	int		 ch, buffer;
-	int		*buffer_ptr;
+	struct args			*args = self->args;
+	struct client			*c = ctx->cmdclient;
+	struct cmd_load_buffer_data	*cdata;
+	struct stat			 sb;
+	struct timeval			 tv;
+	const char			*path;
+	char				*cause;
+	int				 buffer, fd;
 
 	if (!args_has(args, 'b'))
 		buffer = -1;
@@ -81,94 +111,317 @@ cmd_load_buffer_exec(struct cmd *self, struct cmd_ctx *ctx)
 			ctx->error(ctx, "%s: can't read from stdin", path);
 			return (-1);
 		}
+		if (c->stdin_callback != NULL) {
+			ctx->error(ctx, "%s: stdin is busy", path);
+			return (-1);
+		}
+		fd = -1;
+	} else {
+		if ((fd = open(path, O_RDONLY)) == -1) {
+			ctx->error(ctx, "%s: %s", path, strerror(errno));
+			return (-1);
+		}
+		if (fstat(fd, &sb) != 0) {
+			ctx->error(ctx, "%s: %s", path, strerror(errno));
+			close(fd);
+			return (-1);
+		}
+		/*
+		 * A file the server could truncate is read normally, since
+		 * the mapping may lose pages while it is being copied.
+		 */
+		if (args_has(args, 'm') && access(path, W_OK) != 0)
+			return (cmd_load_buffer_map(ctx, path, fd, &sb, buffer));
+	}
 
-		buffer_ptr = xmalloc(sizeof *buffer_ptr);
-		*buffer_ptr = buffer;
+	cdata = xcalloc(1, sizeof *cdata);
+	cdata->buffer = buffer;
 
-		c->stdin_data = buffer_ptr;
-		c->stdin_callback = cmd_load_buffer_callback;
+	cdata->data = NULL;
+	cdata->size = cdata->space = 0;
+	cdata->total = 0;
 
+	cdata->path = xstrdup(path);
+	cdata->fd = fd;
+
+	cdata->c = c;
+	if (c != NULL)
 		c->references++;
+	cdata->report = ctx->curclient;
+	if (cdata->report != NULL)
+		cdata->report->references++;
+	cdata->started = time(NULL);
+	cdata->reported = 0;
+
+	if (fd == -1) {
+		c->stdin_data = cdata;
+		c->stdin_callback = cmd_load_buffer_stdin;
 		bufferevent_enable(c->stdin_event, EV_READ);
 		return (1);
 	}
 
-	if ((f = fopen(path, "rb")) == NULL) {
-		ctx->error(ctx, "%s: %s", path, strerror(errno));
-		return (-1);
+	/*
+	 * If the size is known, the buffer can be allocated once, with a byte
+	 * to spare so the end of the file is seen without growing it.
+	 */
+	if (S_ISREG(sb.st_mode) && sb.st_size > 0) {
+		cdata->total = sb.st_size;
+		if (cmd_load_buffer_grow(cdata, cdata->total + 1) != 0) {
+			ctx->error(ctx, "%s: %s", path, strerror(errno));
+			cmd_load_buffer_free(cdata, NULL);
+			return (-1);
+		}
 	}
 
-	pdata = NULL;
-	psize = 0;
-	while ((ch = getc(f)) != EOF) {
-		/* Do not let the server die due to memory exhaustion. */
-		if ((new_pdata = realloc(pdata, psize + 2)) == NULL) {
-			ctx->error(ctx, "realloc error: %s", strerror(errno));
-			goto error;
-		}
-		pdata = new_pdata;
-		pdata[psize++] = ch;
+	evtimer_set(&cdata->timer, cmd_load_buffer_timer, cdata);
+	memset(&tv, 0, sizeof tv);
+	evtimer_add(&cdata->timer, &tv);
+
+	/* Keep the client until the buffer is read. */
+	return (c != NULL);
+}
+
+/*
+ * Load a file by mapping it and copying it in one go rather than reading it
+ * a piece at a time. The mapping is dropped before anything else can use the
+ * buffer, so a file truncated later doesn't affect it.
+ */
+int
+cmd_load_buffer_map(struct cmd_ctx *ctx,
+    const char *path, int fd, struct stat *sb, int buffer)
+{
+	struct paste_buffer	*pb;
+	void			*map;
+	char			*data;
+	size_t			 size;
+	u_int			 limit;
+
+	if (!S_ISREG(sb->st_mode)) {
+		ctx->error(ctx, "%s: not a regular file", path);
+		close(fd);
+		return (-1);
 	}
-	if (ferror(f)) {
-		ctx->error(ctx, "%s: read error", path);
-		goto error;
+	if (sb->st_size == 0 || (uintmax_t) sb->st_size > SIZE_MAX) {
+		ctx->error(ctx, "%s: bad file size", path);
+		close(fd);
+		return (-1);
 	}
-	if (pdata != NULL)
-		pdata[psize] = '\0';
 
-	fclose(f);
+	size = sb->st_size;
+
+	/* Not xmalloc, so a large file can't make the server die. */
+	if ((data = malloc(size + 1)) == NULL) {
+		ctx->error(ctx, "%s: %s", path, strerror(errno));
+		close(fd);
+		return (-1);
+	}
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		ctx->error(ctx, "%s: %s", path, strerror(errno));
+		xfree(data);
+		return (-1);
+	}
+	memcpy(data, map, size);
+	data[size] = '\0';
+	munmap(map, size);
+	pb = paste_create(data, size);
 
 	limit = options_get_number(&global_options, "buffer-limit");
 	if (buffer == -1) {
-		paste_add(&global_buffers, pdata, psize, limit);
+		paste_push(&global_buffers, pb, limit);
 		return (0);
 	}
-	if (paste_replace(&global_buffers, buffer, pdata, psize) != 0) {
+	if (paste_set(&global_buffers, buffer, pb) != 0) {
 		ctx->error(ctx, "no buffer %d", buffer);
+		paste_free(pb);
 		return (-1);
 	}
+	return (0);
+}
+
+/*
+ * Make room for at least size more bytes and a terminating nul. Use malloc
+ * rather than xmalloc so a large file can't make the server die.
+ */
+int
+cmd_load_buffer_grow(struct cmd_load_buffer_data *cdata, size_t size)
+{
+	char	*new_data;
+	size_t	 space;
+
+	if (cdata->space - cdata->size > size)
+		return (0);
 
+	space = cdata->size + size + 1;
+	if (space <= cdata->size) {
+		errno = ENOMEM;
+		return (-1);
+	}
+	if ((new_data = realloc(cdata->data, space)) == NULL)
+		return (-1);
+	cdata->data = new_data;
+	cdata->space = space;
 	return (0);
+}
+
+/* Data is available on stdin or stdin has been closed. */
+void
+cmd_load_buffer_stdin(struct client *c, int closed, void *data)
+{
+	struct cmd_load_buffer_data	*cdata = data;
+	size_t				 size;
 
-error:
-	if (pdata != NULL)
-		xfree(pdata);
-	if (f != NULL)
-		fclose(f);
-	return (-1);
+	size = EVBUFFER_LENGTH(c->stdin_event->input);
+	if (size != 0) {
+		if (cmd_load_buffer_grow(cdata, size) != 0) {
+			bufferevent_disable(c->stdin_event, EV_READ);
+			cmd_load_buffer_free(cdata, strerror(errno));
+			return;
+		}
+		bufferevent_read(c->stdin_event, cdata->data + cdata->size, size);
+		cdata->size += size;
+	}
+
+	if (closed) {
+		if (c->flags & CLIENT_DEAD)
+			cmd_load_buffer_free(cdata, "client exited");
+		else
+			cmd_load_buffer_free(cdata, NULL);
+	}
 }
 
+/* Timer for reading a file: read the next piece. */
+/* ARGSUSED */
 void
-cmd_load_buffer_callback(struct client *c, void *data)
+cmd_load_buffer_timer(unused int fd, unused short events, void *data)
 {
-	int	*buffer = data;
-	char	*pdata;
-	size_t	 psize;
-	u_int	 limit;
+	struct cmd_load_buffer_data	*cdata = data;
+	struct timeval			 tv;
+	ssize_t				 n;
 
-	/*
-	 * Event callback has already checked client is not dead and reduced
-	 * its reference count. But tell it to exit.
-	 */
-	c->flags |= CLIENT_EXIT;
+	if (cdata->space - cdata->size < 2 &&
+	    cmd_load_buffer_grow(cdata, PASTE_CHUNK_SIZE) != 0) {
+		cmd_load_buffer_free(cdata, strerror(errno));
+		return;
+	}
 
-	psize = EVBUFFER_LENGTH(c->stdin_event->input);
-	if (psize == 0 || (pdata = malloc(psize + 1)) == NULL) {
-		xfree(data);
+	n = cdata->space - cdata->size - 1;
+	if (n > PASTE_CHUNK_SIZE)
+		n = PASTE_CHUNK_SIZE;
+	n = read(cdata->fd, cdata->data + cdata->size, n);
+	if (n == 0) {
+		cmd_load_buffer_free(cdata, NULL);
 		return;
 	}
-	bufferevent_read(c->stdin_event, pdata, psize);
-	pdata[psize] = '\0';
+	if (n == -1) {
+		if (errno != EINTR && errno != EAGAIN) {
+			cmd_load_buffer_free(cdata, strerror(errno));
+			return;
+		}
+	} else
+		cdata->size += n;
+	cmd_load_buffer_progress(cdata);
 
-	limit = options_get_number(&global_options, "buffer-limit");
-	if (*buffer == -1)
-		paste_add(&global_buffers, pdata, psize, limit);
-	else if (paste_replace(&global_buffers, *buffer, pdata, psize) != 0) {
-		/* No context so can't use server_client_msg_error. */
-		evbuffer_add_printf(
-		    c->stderr_event->output, "no buffer %d\n", *buffer);
-		bufferevent_enable(c->stderr_event, EV_WRITE);
+	memset(&tv, 0, sizeof tv);
+	evtimer_add(&cdata->timer, &tv);
+}
+
+/*
+ * Tell the attached client that ran the command how far it has got, once a
+ * second after the first.
+ */
+void
+cmd_load_buffer_progress(struct cmd_load_buffer_data *cdata)
+{
+	struct client	*c = cdata->report;
+	time_t		 t;
+
+	if (c == NULL || c->flags & CLIENT_DEAD || c->session == NULL)
+		return;
+	if (c->prompt_string != NULL)
+		return;
+
+	t = time(NULL);
+	if (t == cdata->started || t == cdata->reported)
+		return;
+	cdata->reported = t;
+
+	if (cdata->total == 0 || cdata->size > cdata->total) {
+		status_message_set(c, "Loading buffer from %s: %zu bytes",
+		    cdata->path, cdata->size);
+	} else {
+		status_message_set(c, "Loading buffer from %s: %llu%%",
+		    cdata->path,
+		    (unsigned long long) cdata->size * 100 / cdata->total);
+	}
+}
+
+/*
+ * Finished reading, add the buffer if there was no error, report any error
+ * and let the client exit.
+ */
+void
+cmd_load_buffer_free(struct cmd_load_buffer_data *cdata, const char *cause)
+{
+	struct client	*c;
+	char		*msg;
+	u_int		 limit;
+
+	msg = NULL;
+	if (cause != NULL)
+		xasprintf(&msg, "%s: %s", cdata->path, cause);
+	else if (cdata->size != 0) {
+		cdata->data[cdata->size] = '\0';
+
+		limit = options_get_number(&global_options, "buffer-limit");
+		if (cdata->buffer == -1) {
+			paste_add(&global_buffers,
+			    cdata->data, cdata->size, limit);
+			cdata->data = NULL;
+		} else if (paste_replace(&global_buffers,
+		    cdata->buffer, cdata->data, cdata->size) == 0)
+			cdata->data = NULL;
+		else
+			xasprintf(&msg, "no buffer %d", cdata->buffer);
+	}
+
+	if (cdata->fd != -1)
+		close(cdata->fd);
+
+	if ((c = cdata->c) != NULL) {
+		if (c->stdin_callback == cmd_load_buffer_stdin) {
+			c->stdin_callback = NULL;
+			c->stdin_data = NULL;
+		}
+
+		if (msg != NULL && !(c->flags & CLIENT_DEAD)) {
+			evbuffer_add_printf(c->stderr_event->output,
+			    "%s\n", msg);
+			bufferevent_enable(c->stderr_event, EV_WRITE);
+			c->retcode = 1;
+		}
+
+		c->flags |= CLIENT_EXIT;
+		c->references--;
+	}
+
+	if ((c = cdata->report) != NULL) {
+		if (!(c->flags & CLIENT_DEAD) && c->session != NULL) {
+			if (msg != NULL)
+				status_message_set(c, "%s", msg);
+			else if (cdata->reported != 0) {
+				status_message_set(c,
+				    "Loaded buffer from %s", cdata->path);
+			}
+		}
+		c->references--;
 	}
 
-	xfree(data);
+	if (msg != NULL)
+		xfree(msg);
+	if (cdata->data != NULL)
+		free(cdata->data);
+	xfree(cdata->path);
+	xfree(cdata);
 }
@@ -196,7 +196,7 @@ cmd_new_session_exec(struct cmd *self, struct cmd_ctx *ctx)
 		cmd = options_get_string(&global_s_options, "default-command");
 
 	/* Construct the environment. */
-	environ_init(&env);
+	environ_init(&env, NULL);
 	update = options_get_string(&global_s_options, "update-environment");
 	if (ctx->cmdclient != NULL)
 		environ_update(update, &ctx->cmdclient->environ, &env);
@@ -29,13 +29,10 @@
 
 int	cmd_paste_buffer_exec(struct cmd *, struct cmd_ctx *);
 
-void	cmd_paste_buffer_filter(
-	    struct window_pane *, const char *, size_t, const char *);
-
 const struct cmd_entry cmd_paste_buffer_entry = {
 	"paste-buffer", "pasteb",
-	"db:rs:t:", 0, 0,
-	"[-dr] [-s separator] [-b buffer-index] [-t target-pane]",
+	"db:prs:t:", 0, 0,
+	"[-dpr] [-s separator] [-b buffer-index] [-t target-pane]",
 	0,
 	NULL,
 	NULL,
@@ -51,7 +48,7 @@ cmd_paste_buffer_exec(struct cmd *self, struct cmd_ctx *ctx)
 	struct paste_buffer	*pb;
 	const char		*sepstr;
 	char			*cause;
-	int			 buffer;
+	int			 buffer, bracket;
 
 	if (cmd_find_pane(ctx, args_get(args, 't'), &s, &wp) == NULL)
 		return (-1);
@@ -85,7 +82,11 @@ cmd_paste_buffer_exec(struct cmd *self, struct cmd_ctx *ctx)
 			else
 				sepstr = "\r";
 		}
-		cmd_paste_buffer_filter(wp, pb->data, pb->size, sepstr);
+
+		/* Only bracket the paste if the application asked for it. */
+		bracket = args_has(args, 'p') &&
+		    (wp->base.mode & MODE_BRACKETPASTE);
+		window_pane_paste(wp, pb, sepstr, bracket);
 	}
 
 	/* Delete the buffer if -d. */
@@ -98,24 +99,3 @@ cmd_paste_buffer_exec(struct cmd *self, struct cmd_ctx *ctx)
 
 	return (0);
 }
-
-/* Add bytes to a buffer and filter '\n' according to separator. */
-void
-cmd_paste_buffer_filter(
-    struct window_pane *wp, const char *data, size_t size, const char *sep)
-{
-	const char	*end = data + size;
-	const char	*lf;
-	size_t		 seplen;
-
-	seplen = strlen(sep);
-	while ((lf = memchr(data, '\n', end - data)) != NULL) {
-		if (lf != data)
-			bufferevent_write(wp->event, data, lf - data);
-		bufferevent_write(wp->event, sep, seplen);
-		data = lf + 1;
-	}
-
-	if (end != data)
-		bufferevent_write(wp->event, data, end - data);
-}
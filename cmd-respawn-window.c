@@ -64,9 +64,6 @@ cmd_respawn_window_exec(struct cmd *self, struct cmd_ctx *ctx)
 		}
 	}
 
-	environ_init(&env);
-	environ_copy(&global_environ, &env);
-	environ_copy(&s->environ, &env);
 	server_fill_environ(s, &env);
 
 	wp = TAILQ_FIRST(&w->panes);
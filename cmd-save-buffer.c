@@ -20,16 +20,40 @@
 #include <sys/stat.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "tmux.h"
 
 /*
  * Saves a session paste buffer to a file.
+ *
+ * The buffer is written a piece at a time from the event loop, so saving a
+ * large buffer to a slow file system doesn't stop the server.
  */
 
+struct cmd_save_buffer_data {
+	struct paste_buffer	*pb;
+	size_t			 offset;
+
+	char			*path;
+	int			 fd;
+	struct event		 timer;
+
+	struct client		*c;		/* client waiting for exit */
+	struct client		*report;	/* client shown progress */
+	time_t			 started;
+	time_t			 reported;
+};
+
 int	cmd_save_buffer_exec(struct cmd *, struct cmd_ctx *);
 
+void	cmd_save_buffer_stdout(struct client *, int, void *);
+void	cmd_save_buffer_timer(int, short, void *);
+void	cmd_save_buffer_progress(struct cmd_save_buffer_data *);
+void	cmd_save_buffer_free(struct cmd_save_buffer_data *, const char *);
+
 const struct cmd_entry cmd_save_buffer_entry = {
 	"save-buffer", "saveb",
 	"ab:", 1, 1,
@@ -43,14 +67,15 @@ const struct cmd_entry cmd_save_buffer_entry = {
 int
 cmd_save_buffer_exec(struct cmd *self, struct cmd_ctx *ctx)
 {
-	struct args		*args = self->args;
-	struct client		*c = ctx->cmdclient;
-	struct paste_buffer	*pb;
-	const char		*path;
-	char			*cause;
-	int			 buffer;
-	mode_t			 mask;
-	FILE			*f;
+	struct args			*args = self->args;
+	struct client			*c = ctx->cmdclient;
+	struct paste_buffer		*pb;
+	struct cmd_save_buffer_data	*cdata;
+	struct timeval			 tv;
+	const char			*path;
+	char				*cause;
+	int				 buffer, fd, flags;
+	mode_t				 mask;
 
 	if (!args_has(args, 'b')) {
 		if ((pb = paste_get_top(&global_buffers)) == NULL) {
@@ -74,29 +99,181 @@ cmd_save_buffer_exec(struct cmd *self, struct cmd_ctx *ctx)
 
 	path = args->argv[0];
 	if (strcmp(path, "-") == 0) {
-		if (c == NULL) {
+		if (c == NULL || c->stdout_fd == -1) {
 			ctx->error(ctx, "%s: can't write to stdout", path);
 			return (-1);
 		}
-		bufferevent_write(c->stdout_event, pb->data, pb->size);
+		if (c->stdout_callback != NULL) {
+			ctx->error(ctx, "%s: stdout is busy", path);
+			return (-1);
+		}
+		fd = -1;
 	} else {
-		mask = umask(S_IRWXG | S_IRWXO);
+		flags = O_WRONLY|O_CREAT;
 		if (args_has(self->args, 'a'))
-			f = fopen(path, "ab");
+			flags |= O_APPEND;
 		else
-			f = fopen(path, "wb");
+			flags |= O_TRUNC;
+
+		mask = umask(S_IRWXG | S_IRWXO);
+		fd = open(path, flags, 0666);
 		umask(mask);
-		if (f == NULL) {
+		if (fd == -1) {
 			ctx->error(ctx, "%s: %s", path, strerror(errno));
 			return (-1);
 		}
-		if (fwrite(pb->data, 1, pb->size, f) != pb->size) {
-			ctx->error(ctx, "%s: fwrite error", path);
-			fclose(f);
-			return (-1);
+	}
+
+	cdata = xcalloc(1, sizeof *cdata);
+	cdata->pb = pb;
+	pb->references++;
+	cdata->offset = 0;
+
+	cdata->path = xstrdup(path);
+	cdata->fd = fd;
+
+	cdata->c = c;
+	if (c != NULL)
+		c->references++;
+	cdata->report = ctx->curclient;
+	if (cdata->report != NULL)
+		cdata->report->references++;
+	cdata->started = time(NULL);
+	cdata->reported = 0;
+
+	if (fd == -1) {
+		c->stdout_data = cdata;
+		c->stdout_callback = cmd_save_buffer_stdout;
+		cmd_save_buffer_stdout(c, 0, cdata);
+	} else {
+		evtimer_set(&cdata->timer, cmd_save_buffer_timer, cdata);
+		memset(&tv, 0, sizeof tv);
+		evtimer_add(&cdata->timer, &tv);
+	}
+
+	/* Keep the client until the buffer is written. */
+	return (c != NULL);
+}
+
+/* Client stdout has been written or closed, write the next piece. */
+void
+cmd_save_buffer_stdout(struct client *c, int closed, void *data)
+{
+	struct cmd_save_buffer_data	*cdata = data;
+	struct paste_buffer		*pb = cdata->pb;
+	size_t				 size;
+
+	if (closed) {
+		cmd_save_buffer_free(cdata, "stdout closed");
+		return;
+	}
+
+	size = pb->size - cdata->offset;
+	if (size > PASTE_CHUNK_SIZE)
+		size = PASTE_CHUNK_SIZE;
+	bufferevent_write(c->stdout_event, pb->data + cdata->offset, size);
+	cdata->offset += size;
+
+	if (cdata->offset == pb->size)
+		cmd_save_buffer_free(cdata, NULL);
+}
+
+/* Timer for writing to a file: write the next piece. */
+/* ARGSUSED */
+void
+cmd_save_buffer_timer(unused int fd, unused short events, void *data)
+{
+	struct cmd_save_buffer_data	*cdata = data;
+	struct paste_buffer		*pb = cdata->pb;
+	struct timeval			 tv;
+	size_t				 size;
+	ssize_t				 n;
+
+	size = pb->size - cdata->offset;
+	if (size > PASTE_CHUNK_SIZE)
+		size = PASTE_CHUNK_SIZE;
+	if ((n = write(cdata->fd, pb->data + cdata->offset, size)) == -1) {
+		if (errno != EINTR && errno != EAGAIN) {
+			cmd_save_buffer_free(cdata, strerror(errno));
+			return;
+		}
+	} else
+		cdata->offset += n;
+
+	if (cdata->offset == pb->size) {
+		cmd_save_buffer_free(cdata, NULL);
+		return;
+	}
+	cmd_save_buffer_progress(cdata);
+
+	memset(&tv, 0, sizeof tv);
+	evtimer_add(&cdata->timer, &tv);
+}
+
+/*
+ * Tell the attached client that ran the command how far it has got, once a
+ * second after the first.
+ */
+void
+cmd_save_buffer_progress(struct cmd_save_buffer_data *cdata)
+{
+	struct client	*c = cdata->report;
+	time_t		 t;
+
+	if (c == NULL || c->flags & CLIENT_DEAD || c->session == NULL)
+		return;
+	if (c->prompt_string != NULL)
+		return;
+
+	t = time(NULL);
+	if (t == cdata->started || t == cdata->reported)
+		return;
+	cdata->reported = t;
+
+	status_message_set(c, "Saving buffer to %s: %llu%%", cdata->path,
+	    (unsigned long long) cdata->offset * 100 / cdata->pb->size);
+}
+
+/* Finished writing, report any error and let the client exit. */
+void
+cmd_save_buffer_free(struct cmd_save_buffer_data *cdata, const char *cause)
+{
+	struct client	*c;
+
+	if (cdata->fd != -1 && close(cdata->fd) != 0 && cause == NULL)
+		cause = strerror(errno);
+
+	if ((c = cdata->c) != NULL) {
+		if (c->stdout_callback == cmd_save_buffer_stdout) {
+			c->stdout_callback = NULL;
+			c->stdout_data = NULL;
+		}
+
+		if (cause != NULL && !(c->flags & CLIENT_DEAD)) {
+			evbuffer_add_printf(c->stderr_event->output,
+			    "%s: %s\n", cdata->path, cause);
+			bufferevent_enable(c->stderr_event, EV_WRITE);
+			c->retcode = 1;
+		}
+
+		c->flags |= CLIENT_EXIT;
+		c->references--;
+	}
+
+	if ((c = cdata->report) != NULL) {
+		if (!(c->flags & CLIENT_DEAD) && c->session != NULL) {
+			if (cause != NULL) {
+				status_message_set(c,
+				    "%s: %s", cdata->path, cause);
+			} else if (cdata->reported != 0) {
+				status_message_set(c,
+				    "Saved buffer to %s", cdata->path);
+			}
 		}
-		fclose(f);
+		c->references--;
 	}
 
-	return (0);
+	paste_free(cdata->pb);
+	xfree(cdata->path);
+	xfree(cdata);
 }
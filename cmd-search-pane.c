@@ -0,0 +1,87 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+
+#include <string.h>
+
+#include "tmux.h"
+
+/*
+ * Print the numbers of the lines in a pane containing a string.
+ */
+
+int	cmd_search_pane_exec(struct cmd *, struct cmd_ctx *);
+
+const struct cmd_entry cmd_search_pane_entry = {
+	"search-pane", "searchp",
+	"t:", 1, 1,
+	CMD_TARGET_PANE_USAGE " string",
+	0,
+	NULL,
+	NULL,
+	cmd_search_pane_exec
+};
+
+int
+cmd_search_pane_exec(struct cmd *self, struct cmd_ctx *ctx)
+{
+	struct args		*args = self->args;
+	struct window_pane	*wp;
+	struct grid		*gd;
+	struct grid_index_query	 gq;
+	const char		*str;
+	char			*buf;
+	size_t			 size;
+	u_int			 py, next;
+	int			 indexed;
+
+	if (cmd_find_pane(ctx, args_get(args, 't'), NULL, &wp) == NULL)
+		return (-1);
+	gd = wp->base.grid;
+	str = args->argv[0];
+
+	indexed = 0;
+	if (window_pane_get_index(wp) != NULL) {
+		if (grid_index_query_init(gd, &gq, str, strlen(str)) == 0)
+			indexed = 1;
+	}
+
+	buf = NULL;
+	size = 0;
+	for (py = 0; py < gd->hsize + gd->sy; py++) {
+		/* Skip history lines which cannot match. */
+		if (indexed && py < gd->hsize) {
+			if (grid_index_next(gd, &gq, py, 0, &next) != 0)
+				py = gd->hsize;
+			else
+				py = next;
+		}
+
+		grid_string_line(gd, py, &buf, NULL, &size);
+		if (strstr(buf, str) != NULL)
+			ctx->print(ctx, "%d", (int) py - (int) gd->hsize);
+	}
+
+	if (buf != NULL)
+		xfree(buf);
+	if (indexed)
+		grid_index_query_free(&gq);
+
+	return (0);
+}
@@ -83,13 +83,13 @@ cmd_server_info_exec(unused struct cmd *self, struct cmd_ctx *ctx)
 	ctx->print(ctx, "%s", "");
 
 	ctx->print(ctx, "Clients:");
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL)
+	i = 0;
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
 			continue;
 
 		ctx->print(ctx,"%2d: %s (%d, %d): %s [%ux%u %s bs=%hho] "
-		    "[flags=0x%x/0x%x, references=%u]", i, c->tty.path,
+		    "[flags=0x%x/0x%x, references=%u]", i++, c->tty.path,
 		    c->ibuf.fd, c->tty.fd, c->session->name,
 		    c->tty.sx, c->tty.sy, c->tty.termname,
 		    c->tty.tio.c_cc[VERASE], c->flags,
@@ -122,9 +122,9 @@ cmd_set_option_exec(struct cmd *self, struct cmd_ctx *ctx)
 	struct session				*s;
 	struct winlink				*wl;
 	struct client				*c;
+	struct window				*w;
 	struct options				*oo;
 	const char				*optstr, *valstr;
-	u_int					 i;
 
 	/* Get the option name and value. */
 	optstr = args->argv[0];
@@ -183,11 +183,19 @@ cmd_set_option_exec(struct cmd *self, struct cmd_ctx *ctx)
 			return (-1);
 	}
 
+	/* Update window names and timers if their options may have changed. */
+	if (strcmp(oe->name, "automatic-rename") == 0 ||
+	    strcmp(oe->name, "monitor-silence") == 0) {
+		TAILQ_FOREACH(w, &windows, entry) {
+			queue_window_name(w);
+			server_window_silence_schedule(w);
+		}
+	}
+
 	/* Update sizes and redraw. May not need it but meh. */
 	recalculate_sizes();
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c != NULL && c->session != NULL)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session != NULL)
 			server_redraw_client(c);
 	}
 
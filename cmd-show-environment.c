@@ -55,7 +55,7 @@ cmd_show_environment_exec(struct cmd *self, struct cmd_ctx *ctx)
 		env = &s->environ;
 	}
 
-	RB_FOREACH(envent, environ, env) {
+	RB_FOREACH(envent, environ_tree, &env->tree) {
 		if (envent->value != NULL)
 			ctx->print(ctx, "%s=%s", envent->name, envent->value);
 		else
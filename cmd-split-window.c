@@ -68,9 +68,6 @@ cmd_split_window_exec(struct cmd *self, struct cmd_ctx *ctx)
 		return (-1);
 	w = wl->window;
 
-	environ_init(&env);
-	environ_copy(&global_environ, &env);
-	environ_copy(&s->environ, &env);
 	server_fill_environ(s, &env);
 
 	if (args->argc == 0)
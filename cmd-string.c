@@ -29,14 +29,49 @@
 
 /*
  * Parse a command from a string.
+ *
+ * Command lists are cached by the string they were parsed from, so strings
+ * run repeatedly (by if-shell, confirm-before, choose-window templates and
+ * so on) are only parsed once. The cache holds a reference to each list and
+ * drops the least recently used when it is full. Strings with $ or ~ or
+ * which set environment variables depend on more than the string itself, so
+ * are never cached.
+ *
+ * A string is only added the second time it is parsed, so sourcing a
+ * configuration file, where most lines are seen once, doesn't fill the cache
+ * with lines which will not be used again. The hashes of strings seen once
+ * are kept in a small table for this.
  */
 
+/* Maximum number of cached command lists. */
+#define CMD_STRING_CACHE_SIZE 256
+
+/* Size of the table of strings seen once. */
+#define CMD_STRING_SEEN_SIZE 1024
+
+struct cmd_string_tree cmd_string_tree = RB_INITIALIZER(&cmd_string_tree);
+TAILQ_HEAD(cmd_string_lru, cmd_string_entry) cmd_string_lru =
+    TAILQ_HEAD_INITIALIZER(cmd_string_lru);
+u_int	cmd_string_cached;
+u_int	cmd_string_seen[CMD_STRING_SEEN_SIZE];
+
+int	cmd_string_split(const char *, struct cmd_list **, char **, int *);
+u_int	cmd_string_hash(const char *);
+void	cmd_string_cache_add(const char *, struct cmd_list *);
 int	cmd_string_getc(const char *, size_t *);
 void	cmd_string_ungetc(size_t *);
 char   *cmd_string_string(const char *, size_t *, char, int);
 char   *cmd_string_variable(const char *, size_t *);
 char   *cmd_string_expand_tilde(const char *, size_t *);
 
+RB_GENERATE(cmd_string_tree, cmd_string_entry, entry, cmd_string_cmp);
+
+int
+cmd_string_cmp(struct cmd_string_entry *cse1, struct cmd_string_entry *cse2)
+{
+	return (strcmp(cse1->s, cse2->s));
+}
+
 int
 cmd_string_getc(const char *s, size_t *p)
 {
@@ -55,10 +90,87 @@ cmd_string_ungetc(size_t *p)
 
 /*
  * Parse command string. Returns -1 on error. If returning -1, cause is error
- * string, or NULL for empty command.
+ * string, or NULL for empty command. The list returned may be shared with the
+ * cache so must not be changed; it is released with cmd_list_free as usual.
  */
 int
 cmd_string_parse(const char *s, struct cmd_list **cmdlist, char **cause)
+{
+	struct cmd_string_entry	 find, *cse;
+	u_int			 hash, *seen;
+	int			 assigned;
+
+	find.s = (char *) s;
+	if ((cse = RB_FIND(cmd_string_tree, &cmd_string_tree, &find)) != NULL) {
+		TAILQ_REMOVE(&cmd_string_lru, cse, lru_entry);
+		TAILQ_INSERT_HEAD(&cmd_string_lru, cse, lru_entry);
+
+		*cause = NULL;
+		*cmdlist = cse->cmdlist;
+		(*cmdlist)->references++;
+		return (0);
+	}
+
+	if (cmd_string_split(s, cmdlist, cause, &assigned) != 0)
+		return (-1);
+	if (assigned || strpbrk(s, "$~") != NULL)
+		return (0);
+
+	hash = cmd_string_hash(s);
+	seen = &cmd_string_seen[hash % CMD_STRING_SEEN_SIZE];
+	if (*seen == hash)
+		cmd_string_cache_add(s, *cmdlist);
+	else
+		*seen = hash;
+	return (0);
+}
+
+/* Hash a string for the table of strings seen once. */
+u_int
+cmd_string_hash(const char *s)
+{
+	u_int	hash;
+
+	hash = 2166136261U;
+	for (; *s != '\0'; s++)
+		hash = (hash ^ (u_char) *s) * 16777619U;
+	return (hash);
+}
+
+/* Add a command list to the cache, removing the oldest if it is full. */
+void
+cmd_string_cache_add(const char *s, struct cmd_list *cmdlist)
+{
+	struct cmd_string_entry	*cse;
+
+	if (cmd_string_cached == CMD_STRING_CACHE_SIZE) {
+		cse = TAILQ_LAST(&cmd_string_lru, cmd_string_lru);
+		TAILQ_REMOVE(&cmd_string_lru, cse, lru_entry);
+		RB_REMOVE(cmd_string_tree, &cmd_string_tree, cse);
+		cmd_string_cached--;
+
+		cmd_list_free(cse->cmdlist);
+		xfree(cse->s);
+		xfree(cse);
+	}
+
+	cse = xmalloc(sizeof *cse);
+	cse->s = xstrdup(s);
+	cse->cmdlist = cmdlist;
+	cmdlist->references++;
+
+	RB_INSERT(cmd_string_tree, &cmd_string_tree, cse);
+	TAILQ_INSERT_HEAD(&cmd_string_lru, cse, lru_entry);
+	cmd_string_cached++;
+}
+
+/*
+ * Split a string into arguments and parse them. Sets assigned if any
+ * environment variables were set.
+ */
+int
+cmd_string_split(
+    const char *s, struct cmd_list **cmdlist, char **cause, int *assigned)
 {
 	size_t		p;
 	int		ch, i, argc, rval;
@@ -75,6 +187,7 @@ cmd_string_parse(const char *s, struct cmd_list **cmdlist, char **cause)
 	*cause = NULL;
 
 	*cmdlist = NULL;
+	*assigned = 0;
 	rval = -1;
 
 	p = 0;
@@ -133,6 +246,7 @@ cmd_string_parse(const char *s, struct cmd_list **cmdlist, char **cause)
 				if (equals == NULL || equals > whitespace)
 					break;
 				environ_put(&global_environ, argv[0]);
+				*assigned = 1;
 				argc--;
 				memmove(argv, argv + 1, argc * (sizeof *argv));
 			}
@@ -46,7 +46,6 @@ cmd_swap_window_exec(struct cmd *self, struct cmd_ctx *ctx)
 	struct session		*src, *dst;
 	struct session_group	*sg_src, *sg_dst;
 	struct winlink		*wl_src, *wl_dst;
-	struct window		*w;
 
 	target_src = args_get(args, 's');
 	if ((wl_src = cmd_find_window(ctx, target_src, &src)) == NULL)
@@ -66,9 +65,7 @@ cmd_swap_window_exec(struct cmd *self, struct cmd_ctx *ctx)
 	if (wl_dst->window == wl_src->window)
 		return (0);
 
-	w = wl_dst->window;
-	wl_dst->window = wl_src->window;
-	wl_src->window = w;
+	winlink_swap_windows(wl_dst, wl_src);
 
 	if (!args_has(self->args, 'd')) {
 		session_select(dst, wl_dst->idx);
@@ -59,9 +59,7 @@ cmd_unbind_key_exec(struct cmd *self, unused struct cmd_ctx *ctx)
 	if (args_has(args, 'a')) {
 		while (!SPLAY_EMPTY(&key_bindings)) {
 			bd = SPLAY_ROOT(&key_bindings);
-			SPLAY_REMOVE(key_bindings, &key_bindings, bd);
-			cmd_list_free(bd->cmdlist);
-			xfree(bd);
+			key_bindings_remove(bd->key);
 		}
 		return (0);
 	}
@@ -87,7 +85,6 @@ cmd_unbind_key_table(struct cmd *self, struct cmd_ctx *ctx, int key)
 	struct args			*args = self->args;
 	const char			*tablename;
 	const struct mode_key_table	*mtab;
-	struct mode_key_binding		*mbind, mtmp;
 
 	tablename = args_get(args, 't');
 	if ((mtab = mode_key_findtable(tablename)) == NULL) {
@@ -95,11 +92,6 @@ cmd_unbind_key_table(struct cmd *self, struct cmd_ctx *ctx, int key)
 		return (-1);
 	}
 
-	mtmp.key = key;
-	mtmp.mode = !!args_has(args, 'c');
-	if ((mbind = SPLAY_FIND(mode_key_tree, mtab->tree, &mtmp)) != NULL) {
-		SPLAY_REMOVE(mode_key_tree, mtab->tree, mbind);
-		xfree(mbind);
-	}
+	mode_key_remove(mtab, key, !!args_has(args, 'c'));
 	return (0);
 }
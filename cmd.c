@@ -83,6 +83,7 @@ const struct cmd_entry *cmd_table[] = {
 	&cmd_rotate_window_entry,
 	&cmd_run_shell_entry,
 	&cmd_save_buffer_entry,
+	&cmd_search_pane_entry,
 	&cmd_select_layout_entry,
 	&cmd_select_pane_entry,
 	&cmd_select_window_entry,
@@ -112,8 +113,9 @@ const struct cmd_entry *cmd_table[] = {
 
 struct session	*cmd_choose_session_list(struct sessionslist *);
 struct session	*cmd_choose_session(int);
-struct client	*cmd_choose_client(struct clients *);
+struct client	*cmd_choose_client(struct session *);
 struct client	*cmd_lookup_client(const char *);
+int		 cmd_is_pattern(const char *);
 struct session	*cmd_lookup_session(const char *, int *);
 struct winlink	*cmd_lookup_window(struct session *, const char *, int *);
 int		 cmd_lookup_index(struct session *, const char *, int *);
@@ -198,47 +200,72 @@ cmd_free_argv(int argc, char **argv)
 	xfree(argv);
 }
 
-struct cmd *
-cmd_parse(int argc, char **argv, char **cause)
+/* Find the command table entry for a command name, alias or prefix. */
+const struct cmd_entry *
+cmd_lookup(const char *name, char **cause)
 {
 	const struct cmd_entry **entryp, *entry;
-	struct cmd		*cmd;
-	struct args		*args;
 	char			 s[BUFSIZ];
 	int			 ambiguous = 0;
 
-	*cause = NULL;
-	if (argc == 0) {
-		xasprintf(cause, "no command");
-		return (NULL);
-	}
-
 	entry = NULL;
 	for (entryp = cmd_table; *entryp != NULL; entryp++) {
 		if ((*entryp)->alias != NULL &&
-		    strcmp((*entryp)->alias, argv[0]) == 0) {
+		    strcmp((*entryp)->alias, name) == 0) {
 			ambiguous = 0;
 			entry = *entryp;
 			break;
 		}
 
-		if (strncmp((*entryp)->name, argv[0], strlen(argv[0])) != 0)
+		if (strncmp((*entryp)->name, name, strlen(name)) != 0)
 			continue;
 		if (entry != NULL)
 			ambiguous = 1;
 		entry = *entryp;
 
 		/* Bail now if an exact match. */
-		if (strcmp(entry->name, argv[0]) == 0)
+		if (strcmp(entry->name, name) == 0)
 			break;
 	}
 	if (ambiguous)
 		goto ambiguous;
 	if (entry == NULL) {
-		xasprintf(cause, "unknown command: %s", argv[0]);
+		xasprintf(cause, "unknown command: %s", name);
+		return (NULL);
+	}
+	return (entry);
+
+ambiguous:
+	*s = '\0';
+	for (entryp = cmd_table; *entryp != NULL; entryp++) {
+		if (strncmp((*entryp)->name, name, strlen(name)) != 0)
+			continue;
+		if (strlcat(s, (*entryp)->name, sizeof s) >= sizeof s)
+			break;
+		if (strlcat(s, ", ", sizeof s) >= sizeof s)
+			break;
+	}
+	s[strlen(s) - 2] = '\0';
+	xasprintf(cause, "ambiguous command: %s, could be: %s", name, s);
+	return (NULL);
+}
+
+struct cmd *
+cmd_parse(int argc, char **argv, char **cause)
+{
+	const struct cmd_entry	*entry;
+	struct cmd		*cmd;
+	struct args		*args;
+
+	*cause = NULL;
+	if (argc == 0) {
+		xasprintf(cause, "no command");
 		return (NULL);
 	}
 
+	if ((entry = cmd_lookup(argv[0], cause)) == NULL)
+		return (NULL);
+
 	args = args_parse(entry->args_template, argc, argv);
 	if (args == NULL)
 		goto usage;
@@ -254,20 +281,6 @@ cmd_parse(int argc, char **argv, char **cause)
 	cmd->args = args;
 	return (cmd);
 
-ambiguous:
-	*s = '\0';
-	for (entryp = cmd_table; *entryp != NULL; entryp++) {
-		if (strncmp((*entryp)->name, argv[0], strlen(argv[0])) != 0)
-			continue;
-		if (strlcat(s, (*entryp)->name, sizeof s) >= sizeof s)
-			break;
-		if (strlcat(s, ", ", sizeof s) >= sizeof s)
-			break;
-	}
-	s[strlen(s) - 2] = '\0';
-	xasprintf(cause, "ambiguous command: %s, could be: %s", argv[0], s);
-	return (NULL);
-
 usage:
 	if (args != NULL)
 		args_free(args);
@@ -423,8 +436,6 @@ cmd_current_client(struct cmd_ctx *ctx)
 {
 	struct session		*s;
 	struct client		*c;
-	struct clients		 cc;
-	u_int			 i;
 
 	if (ctx->curclient != NULL)
 		return (ctx->curclient);
@@ -435,37 +446,29 @@ cmd_current_client(struct cmd_ctx *ctx)
 	 */
 	s = cmd_current_session(ctx, 0);
 	if (s != NULL && !(s->flags & SESSION_UNATTACHED)) {
-		ARRAY_INIT(&cc);
-		for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-			if ((c = ARRAY_ITEM(&clients, i)) == NULL)
-				continue;
-			if (s == c->session)
-				ARRAY_ADD(&cc, c);
-		}
-
-		c = cmd_choose_client(&cc);
-		ARRAY_FREE(&cc);
-		if (c != NULL)
+		if ((c = cmd_choose_client(s)) != NULL)
 			return (c);
 	}
 
-	return (cmd_choose_client(&clients));
+	return (cmd_choose_client(NULL));
 }
 
-/* Choose the most recently used client from a list. */
+/*
+ * Choose the most recently used client attached to a session, or to any
+ * session if it is NULL.
+ */
 struct client *
-cmd_choose_client(struct clients *cc)
+cmd_choose_client(struct session *s)
 {
 	struct client	*c, *cbest;
 	struct timeval	*tv = NULL;
-	u_int		 i;
 
 	cbest = NULL;
-	for (i = 0; i < ARRAY_LENGTH(cc); i++) {
-		if ((c = ARRAY_ITEM(cc, i)) == NULL)
-			continue;
+	TAILQ_FOREACH(c, &clients, entry) {
 		if (c->session == NULL)
 			continue;
+		if (s != NULL && c->session != s)
+			continue;
 
 		if (tv == NULL || timercmp(&c->activity_time, tv, >)) {
 			cbest = c;
@@ -514,11 +517,9 @@ cmd_lookup_client(const char *name)
 {
 	struct client	*c;
 	const char	*path;
-	u_int		 i;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
 			continue;
 		path = c->tty.path;
 
@@ -536,11 +537,21 @@ cmd_lookup_client(const char *name)
 	return (NULL);
 }
 
+/*
+ * Could a name match anything other than itself and longer names with it as
+ * a prefix? Names without fnmatch(3) special characters can't.
+ */
+int
+cmd_is_pattern(const char *name)
+{
+	return (strpbrk(name, "*?[\\") != NULL);
+}
+
 /* Lookup a session by name. If no session is found, NULL is returned. */
 struct session *
 cmd_lookup_session(const char *name, int *ambiguous)
 {
-	struct session	*s, *sfound;
+	struct session	*s, *sfound, find;
 
 	*ambiguous = 0;
 
@@ -554,9 +565,25 @@ cmd_lookup_session(const char *name, int *ambiguous)
 
 	/*
 	 * Otherwise look for partial matches, returning early if it is found to
-	 * be ambiguous.
+	 * be ambiguous. Without any pattern characters only a prefix can match;
+	 * sessions are sorted by name, so those are together from the first
+	 * session not before the name.
 	 */
 	sfound = NULL;
+	if (!cmd_is_pattern(name)) {
+		find.name = (char *) name;
+		s = RB_NFIND(sessions, &sessions, &find);
+		for (; s != NULL; s = RB_NEXT(sessions, &sessions, s)) {
+			if (strncmp(name, s->name, strlen(name)) != 0)
+				break;
+			if (sfound != NULL) {
+				*ambiguous = 1;
+				return (NULL);
+			}
+			sfound = s;
+		}
+		return (sfound);
+	}
 	RB_FOREACH(s, sessions, &sessions) {
 		if (strncmp(name, s->name, strlen(name)) == 0 ||
 		    fnmatch(name, s->name, 0) == 0) {
@@ -582,6 +609,7 @@ cmd_lookup_window(struct session *s, const char *name, int *ambiguous)
 	struct winlink	*wl, *wlfound;
 	const char	*errstr;
 	u_int		 idx;
+	int		 pattern;
 
 	*ambiguous = 0;
 
@@ -607,10 +635,11 @@ cmd_lookup_window(struct session *s, const char *name, int *ambiguous)
 		return (wlfound);
 
 	/* Now look for pattern matches, again error if multiple. */
+	pattern = cmd_is_pattern(name);
 	wlfound = NULL;
 	RB_FOREACH(wl, winlinks, &s->windows) {
 		if (strncmp(name, wl->window->name, strlen(name)) == 0 ||
-		    fnmatch(name, wl->window->name, 0) == 0) {
+		    (pattern && fnmatch(name, wl->window->name, 0) == 0)) {
 			if (wlfound != NULL) {
 				*ambiguous = 1;
 				return (NULL);
@@ -674,11 +703,12 @@ cmd_pane_session(struct cmd_ctx *ctx, struct window_pane *wp,
 	struct session		*s;
 	struct sessionslist	 ss;
 	struct winlink		*wl;
+	struct window		*w = wp->window;
 
 	/* If this pane is in the current session, return that winlink. */
 	s = cmd_current_session(ctx, 0);
 	if (s != NULL) {
-		wl = winlink_find_by_window(&s->windows, wp->window);
+		wl = winlink_find_by_window(&s->windows, w);
 		if (wl != NULL) {
 			if (wlp != NULL)
 				*wlp = wl;
@@ -688,14 +718,12 @@ cmd_pane_session(struct cmd_ctx *ctx, struct window_pane *wp,
 
 	/* Otherwise choose from all sessions with this pane. */
 	ARRAY_INIT(&ss);
-	RB_FOREACH(s, sessions, &sessions) {
-		if (winlink_find_by_window(&s->windows, wp->window) != NULL)
-			ARRAY_ADD(&ss, s);
-	}
+	TAILQ_FOREACH(wl, &w->winlinks, wentry)
+		ARRAY_ADD(&ss, wl->session);
 	s = cmd_choose_session_list(&ss);
 	ARRAY_FREE(&ss);
 	if (wlp != NULL)
-		*wlp = winlink_find_by_window(&s->windows, wp->window);
+		*wlp = winlink_find_by_window(&s->windows, w);
 	return (s);
 }
 
@@ -761,16 +789,19 @@ cmd_find_window(struct cmd_ctx *ctx, const char *arg, struct session **sp)
 	int			 ambiguous = 0;
 
 	/*
-	 * Find the current session. There must always be a current session, if
-	 * it can't be found, report an error.
+	 * There must always be a current session, if there are no sessions,
+	 * report an error. Finding it means looking at every session, so it is
+	 * only done if the argument doesn't name a session.
 	 */
-	if ((s = cmd_current_session(ctx, 0)) == NULL) {
+	if (RB_EMPTY(&sessions)) {
 		ctx->error(ctx, "can't establish current session");
 		return (NULL);
 	}
+	s = NULL;
 
 	/* A NULL argument means the current session and window. */
 	if (arg == NULL) {
+		s = cmd_current_session(ctx, 0);
 		if (sp != NULL)
 			*sp = s;
 		return (s->curw);
@@ -800,7 +831,8 @@ cmd_find_window(struct cmd_ctx *ctx, const char *arg, struct session **sp)
 	if (*sessptr != '\0') {
 		if ((s = cmd_lookup_session(sessptr, &ambiguous)) == NULL)
 			goto no_session;
-	}
+	} else
+		s = cmd_current_session(ctx, 0);
 	if (sp != NULL)
 		*sp = s;
 
@@ -828,6 +860,7 @@ no_colon:
 	 * No colon in the string, first try special cases, then as a window
 	 * and lastly as a session.
 	 */
+	s = cmd_current_session(ctx, 0);
 	if (arg[0] == '!' && arg[1] == '\0') {
 		if ((wl = TAILQ_FIRST(&s->lastw)) == NULL)
 			goto not_found;
@@ -908,16 +941,19 @@ cmd_find_index(struct cmd_ctx *ctx, const char *arg, struct session **sp)
 	int		 idx, ambiguous = 0;
 
 	/*
-	 * Find the current session. There must always be a current session, if
-	 * it can't be found, report an error.
+	 * There must always be a current session, if there are no sessions,
+	 * report an error. Finding it means looking at every session, so it is
+	 * only done if the argument doesn't name a session.
 	 */
-	if ((s = cmd_current_session(ctx, 0)) == NULL) {
+	if (RB_EMPTY(&sessions)) {
 		ctx->error(ctx, "can't establish current session");
 		return (-2);
 	}
+	s = NULL;
 
 	/* A NULL argument means the current session and "no window" (-1). */
 	if (arg == NULL) {
+		s = cmd_current_session(ctx, 0);
 		if (sp != NULL)
 			*sp = s;
 		return (-1);
@@ -939,7 +975,8 @@ cmd_find_index(struct cmd_ctx *ctx, const char *arg, struct session **sp)
 	if (sessptr != NULL && *sessptr != '\0') {
 		if ((s = cmd_lookup_session(sessptr, &ambiguous)) == NULL)
 			goto no_session;
-	}
+	} else
+		s = cmd_current_session(ctx, 0);
 	if (sp != NULL)
 		*sp = s;
 
@@ -968,6 +1005,7 @@ no_colon:
 	 * No colon in the string, first try special cases, then as a window
 	 * and lastly as a session.
 	 */
+	s = cmd_current_session(ctx, 0);
 	if (arg[0] == '!' && arg[1] == '\0') {
 		if ((wl = TAILQ_FIRST(&s->lastw)) == NULL)
 			goto not_found;
@@ -1064,16 +1102,17 @@ cmd_find_pane(struct cmd_ctx *ctx,
 	char			*winptr, *paneptr;
 	u_int			 idx;
 
-	/* Get the current session. */
-	if ((s = cmd_current_session(ctx, 0)) == NULL) {
+	/* Check there is a current session; it is only found if needed. */
+	if (RB_EMPTY(&sessions)) {
 		ctx->error(ctx, "can't establish current session");
 		return (NULL);
 	}
-	if (sp != NULL)
-		*sp = s;
 
 	/* A NULL argument means the current session, window and pane. */
 	if (arg == NULL) {
+		s = cmd_current_session(ctx, 0);
+		if (sp != NULL)
+			*sp = s;
 		*wpp = s->curw->window->active;
 		return (s->curw);
 	}
@@ -1093,9 +1132,12 @@ cmd_find_pane(struct cmd_ctx *ctx,
 	/* Pull out the window part and parse it. */
 	winptr = xstrdup(arg);
 	winptr[period - arg] = '\0';
-	if (*winptr == '\0')
+	if (*winptr == '\0') {
+		s = cmd_current_session(ctx, 0);
+		if (sp != NULL)
+			*sp = s;
 		wl = s->curw;
-	else if ((wl = cmd_find_window(ctx, winptr, sp)) == NULL)
+	} else if ((wl = cmd_find_window(ctx, winptr, sp)) == NULL)
 		goto error;
 
 	/* Find the pane section and look it up. */
@@ -1128,6 +1170,10 @@ lookup_string:
 	return (wl);
 
 no_period:
+	s = cmd_current_session(ctx, 0);
+	if (sp != NULL)
+		*sp = s;
+
 	/* Try as a pane number alone. */
 	idx = strtonum(arg, 0, INT_MAX, &errstr);
 	if (errstr != NULL)
@@ -0,0 +1,331 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <event.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tmux.h"
+
+/*
+ * Control mode. A client started with -C reads commands a line at a time from
+ * its standard input and runs them in the server over the one connection.
+ * The output of each command is written to its standard output between a
+ * "%begin" line and an "%end" or "%error" line, each giving the number of
+ * the command. A command which finishes later, such as run-shell, holds a
+ * reference to the client: its "%end" is delayed and no more lines are read
+ * until it is released. With -CC, the client is also sent a "%output" line
+ * for data from any pane and a "%layout-change" line when a window's layout
+ * changes.
+ */
+
+void	control_callback(struct client *, int, void *);
+void	control_read(struct client *);
+void	control_command(struct client *, char *);
+void	control_end(struct client *, u_int, int);
+void	control_vwrite(struct client *, const char *, va_list);
+void printflike2 control_write(struct client *, const char *, ...);
+
+void printflike2 control_msg_error(struct cmd_ctx *, const char *, ...);
+void printflike2 control_msg_print(struct cmd_ctx *, const char *, ...);
+void printflike2 control_msg_info(struct cmd_ctx *, const char *, ...);
+
+/* Start control mode on a client, reading commands from its stdin. */
+void
+control_start(struct client *c)
+{
+	struct stat	 sb;
+	struct evbuffer	*evb;
+	char		 buf[BUFSIZ];
+	ssize_t		 n;
+
+	c->flags |= CLIENT_CONTROL;
+	c->control_seq = 0;
+	c->control_pending = 0;
+
+	c->stdin_callback = control_callback;
+	c->stdin_data = NULL;
+	if (fstat(c->stdin_fd, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+		if (bufferevent_enable(c->stdin_event, EV_READ) == 0)
+			return;
+	}
+
+	/*
+	 * Files (and /dev/null) can't be polled, so read them now and keep
+	 * what isn't run yet until the client is freed.
+	 */
+	evb = evbuffer_new();
+	while ((n = read(c->stdin_fd, buf, sizeof buf)) > 0)
+		evbuffer_add(evb, buf, n);
+	c->stdin_data = evb;
+	control_read(c);
+
+	setblocking(c->stdin_fd, 1);
+	close(c->stdin_fd);
+	c->stdin_fd = -1;
+	control_callback(c, 1, evb);
+}
+
+/* Write a line to a control client from a va_list. */
+void
+control_vwrite(struct client *c, const char *fmt, va_list ap)
+{
+	if (c->stdout_event == NULL)
+		return;
+
+	evbuffer_add_vprintf(c->stdout_event->output, fmt, ap);
+	bufferevent_write(c->stdout_event, "\n", 1);
+}
+
+/* Write a line to a control client. */
+void printflike2
+control_write(struct client *c, const char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	control_vwrite(c, fmt, ap);
+	va_end(ap);
+}
+
+/* Data is available on stdin or stdin has been closed. */
+void
+control_callback(struct client *c, int closed, void *data)
+{
+	if (closed) {
+		c->flags |= CLIENT_EXIT;
+		if (c->flags & CLIENT_DEAD && data != NULL) {
+			evbuffer_free(data);
+			c->stdin_data = NULL;
+		}
+		return;
+	}
+	control_read(c);
+}
+
+/*
+ * Run each complete line read from stdin as a command, stopping if one has
+ * not yet finished.
+ */
+void
+control_read(struct client *c)
+{
+	struct evbuffer	*evb;
+	char		*line;
+
+	if (c->stdin_data != NULL)
+		evb = c->stdin_data;
+	else
+		evb = c->stdin_event->input;
+	while (c->control_pending == 0) {
+		line = evbuffer_readline(evb);
+		if (line == NULL)
+			break;
+		control_command(c, line);
+		xfree(line);
+		if (c->flags & CLIENT_DEAD)
+			break;
+	}
+}
+
+/*
+ * Check if a command which has not finished has released the client and if
+ * so end it and run any more lines waiting.
+ */
+void
+control_check(struct client *c)
+{
+	if (c->control_pending == 0 ||
+	    c->references > c->control_references)
+		return;
+
+	control_end(c, c->control_pending, c->control_error);
+	c->control_pending = 0;
+
+	control_read(c);
+}
+
+/* Run a command line and write its output. */
+void
+control_command(struct client *c, char *line)
+{
+	struct cmd_ctx	 ctx;
+	struct cmd_list	*cmdlist;
+	char		*cause;
+	u_int		 seq;
+	int		 references, retval;
+
+	if (*line == '\0')
+		return;
+	seq = ++c->control_seq;
+
+	ctx.error = control_msg_error;
+	ctx.print = control_msg_print;
+	ctx.info = control_msg_info;
+
+	ctx.msgdata = NULL;
+	ctx.curclient = NULL;
+	ctx.cmdclient = c;
+
+	control_write(c, "%%begin %u", seq);
+	c->control_error = 0;
+	references = c->references;
+	if (cmd_string_parse(line, &cmdlist, &cause) != 0) {
+		control_write(c, "%s", cause);
+		xfree(cause);
+		retval = -1;
+	} else if (cmdlist == NULL)
+		retval = 0;
+	else {
+		retval = cmd_list_exec(cmdlist, &ctx);
+		cmd_list_free(cmdlist);
+	}
+
+	/* A command still holding the client will print more when done. */
+	if (retval == 1 && c->references > references) {
+		c->control_pending = seq;
+		c->control_references = references;
+		return;
+	}
+	control_end(c, seq, retval == -1);
+}
+
+/* Write the line ending the output of a command. */
+void
+control_end(struct client *c, u_int seq, int error)
+{
+	if (error)
+		control_write(c, "%%error %u", seq);
+	else
+		control_write(c, "%%end %u", seq);
+}
+
+/* Command error callback. */
+void printflike2
+control_msg_error(struct cmd_ctx *ctx, const char *fmt, ...)
+{
+	va_list	ap;
+
+	ctx->cmdclient->control_error = 1;
+
+	va_start(ap, fmt);
+	control_vwrite(ctx->cmdclient, fmt, ap);
+	va_end(ap);
+}
+
+/* Command print callback. */
+void printflike2
+control_msg_print(struct cmd_ctx *ctx, const char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	control_vwrite(ctx->cmdclient, fmt, ap);
+	va_end(ap);
+}
+
+/* Command info callback, if not quiet. */
+void printflike2
+control_msg_info(struct cmd_ctx *ctx, const char *fmt, ...)
+{
+	va_list	ap;
+
+	if (options_get_number(&global_options, "quiet"))
+		return;
+
+	va_start(ap, fmt);
+	control_vwrite(ctx->cmdclient, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * Tell control clients about data read from a pane. A client which has not
+ * read enough of its output to stay under CONTROL_OUTPUT_MAX is disconnected
+ * rather than buffering without limit.
+ */
+void
+control_notify_output(struct window_pane *wp, const u_char *buf, size_t len)
+{
+	struct client	*c, *c_next;
+	struct evbuffer	*evb;
+	size_t		 i, start;
+
+	c_next = TAILQ_FIRST(&clients);
+	while (c_next != NULL) {
+		c = c_next;
+		c_next = TAILQ_NEXT(c, entry);
+
+		if (!(c->flags & CLIENT_CONTROLNOTIFY))
+			continue;
+		if (c->stdout_event == NULL)
+			continue;
+		evb = c->stdout_event->output;
+		if (EVBUFFER_LENGTH(evb) > CONTROL_OUTPUT_MAX) {
+			log_debug("control client %d too far behind",
+			    c->ibuf.fd);
+			server_client_lost(c);
+			continue;
+		}
+
+		/* Escape control characters and backslashes as octal. */
+		evbuffer_add_printf(evb, "%%output %%%u ", wp->id);
+		start = 0;
+		for (i = 0; i < len; i++) {
+			if (buf[i] >= ' ' && buf[i] != '\\')
+				continue;
+			evbuffer_add(evb, buf + start, i - start);
+			evbuffer_add_printf(evb, "\\%03o", buf[i]);
+			start = i + 1;
+		}
+		evbuffer_add(evb, buf + start, len - start);
+		bufferevent_write(c->stdout_event, "\n", 1);
+	}
+}
+
+/* Tell control clients that the layout of a window has changed. */
+void
+control_notify_layout(struct window *w)
+{
+	struct client	*c;
+	struct winlink	*wl;
+	char		*layout;
+
+	layout = NULL;
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (!(c->flags & CLIENT_CONTROLNOTIFY))
+			continue;
+
+		if (layout == NULL) {
+			if (w->layout_root == NULL)
+				return;
+			if ((layout = layout_dump(w)) == NULL)
+				return;
+		}
+		TAILQ_FOREACH(wl, &w->winlinks, wentry) {
+			control_write(c, "%%layout-change %s:%d %s",
+			    wl->session->name, wl->idx, layout);
+		}
+	}
+	if (layout != NULL)
+		xfree(layout);
+}
@@ -25,9 +25,20 @@
 
 /*
  * Environment - manipulate a set of environment variables.
+ *
+ * An environment may have a parent, so the environment for a new process is
+ * a few variables on top of the session environment, which is itself on top
+ * of the global environment, rather than a copy of them all. The NAME=VALUE
+ * list passed to a new process is built once for each environment and kept
+ * until a variable in it or one of its parents changes.
  */
 
-RB_GENERATE(environ, environ_entry, entry, environ_cmp);
+u_int	environ_generation(struct environ *);
+int	environ_sort_cmp(const void *, const void *);
+int	environ_hidden(struct environ *, struct environ *, const char *);
+void	environ_free_envp(struct environ *);
+
+RB_GENERATE(environ_tree, environ_entry, entry, environ_cmp);
 
 int
 environ_cmp(struct environ_entry *envent1, struct environ_entry *envent2)
@@ -37,9 +48,15 @@ environ_cmp(struct environ_entry *envent1, struct environ_entry *envent2)
 
 /* Initialise the environment. */
 void
-environ_init(struct environ *env)
+environ_init(struct environ *env, struct environ *parent)
 {
-	RB_INIT(env);
+	RB_INIT(&env->tree);
+	env->parent = parent;
+
+	env->generation = 0;
+
+	env->envp = NULL;
+	env->envp_generation = 0;
 }
 
 /* Free an environment. */
@@ -48,14 +65,29 @@ environ_free(struct environ *env)
 {
 	struct environ_entry	*envent;
 
-	while (!RB_EMPTY(env)) {
-		envent = RB_ROOT(env);
-		RB_REMOVE(environ, env, envent);
+	while (!RB_EMPTY(&env->tree)) {
+		envent = RB_ROOT(&env->tree);
+		RB_REMOVE(environ_tree, &env->tree, envent);
 		xfree(envent->name);
 		if (envent->value != NULL)
 			xfree(envent->value);
 		xfree(envent);
 	}
+	environ_free_envp(env);
+}
+
+/* Free the cached variable list. */
+void
+environ_free_envp(struct environ *env)
+{
+	char	**envp;
+
+	if (env->envp == NULL)
+		return;
+	for (envp = env->envp; *envp != NULL; envp++)
+		xfree(*envp);
+	xfree(env->envp);
+	env->envp = NULL;
 }
 
 /* Copy one environment into another. */
@@ -64,7 +96,7 @@ environ_copy(struct environ *srcenv, struct environ *dstenv)
 {
 	struct environ_entry	*envent;
 
-	RB_FOREACH(envent, environ, srcenv)
+	RB_FOREACH(envent, environ_tree, &srcenv->tree)
 		environ_set(dstenv, envent->name, envent->value);
 }
 
@@ -75,7 +107,7 @@ environ_find(struct environ *env, const char *name)
 	struct environ_entry	envent;
 
 	envent.name = (char *) name;
-	return (RB_FIND(environ, env, &envent));
+	return (RB_FIND(environ_tree, &env->tree, &envent));
 }
 
 /* Set an environment variable. */
@@ -84,6 +116,7 @@ environ_set(struct environ *env, const char *name, const char *value)
 {
 	struct environ_entry	*envent;
 
+	env->generation++;
 	if ((envent = environ_find(env, name)) != NULL) {
 		if (envent->value != NULL)
 			xfree(envent->value);
@@ -98,7 +131,7 @@ environ_set(struct environ *env, const char *name, const char *value)
 			envent->value = xstrdup(value);
 		else
 			envent->value = NULL;
-		RB_INSERT(environ, env, envent);
+		RB_INSERT(environ_tree, &env->tree, envent);
 	}
 }
 
@@ -128,7 +161,8 @@ environ_unset(struct environ *env, const char *name)
 
 	if ((envent = environ_find(env, name)) == NULL)
 		return;
-	RB_REMOVE(environ, env, envent);
+	env->generation++;
+	RB_REMOVE(environ_tree, &env->tree, envent);
 	xfree(envent->name);
 	if (envent->value != NULL)
 		xfree(envent->value);
@@ -155,27 +189,108 @@ environ_update(const char *vars, struct environ *srcenv, struct environ *dstenv)
 	xfree(copyvars);
 }
 
-/* Push environment into the real environment - use after fork(). */
+/*
+ * Get the generation of an environment and its parents. Each only ever
+ * increases, so the sum changes whenever any of them does.
+ */
+u_int
+environ_generation(struct environ *env)
+{
+	u_int	generation;
+
+	generation = 0;
+	for (; env != NULL; env = env->parent)
+		generation += env->generation;
+	return (generation);
+}
+
+/* Compare two variables for sorting. */
+int
+environ_sort_cmp(const void *a, const void *b)
+{
+	struct environ_entry *const	*envent1 = a, *const *envent2 = b;
+
+	return (environ_cmp(*envent1, *envent2));
+}
+
+/* Is a variable in an environment hidden by one in an environment above? */
+int
+environ_hidden(struct environ *env, struct environ *layer, const char *name)
+{
+	for (; env != layer; env = env->parent) {
+		if (environ_find(env, name) != NULL)
+			return (1);
+	}
+	return (0);
+}
+
+/*
+ * Get the NAME=VALUE list for an environment and its parents, sorted by name.
+ * The list belongs to the environment and is rebuilt only if a variable has
+ * changed since it was last built.
+ */
+char **
+environ_envp(struct environ *env)
+{
+	struct environ		*layer;
+	struct environ_entry	*envent, **list;
+	u_int			 generation, n, i;
+
+	generation = environ_generation(env);
+	if (env->envp != NULL && env->envp_generation == generation)
+		return (env->envp);
+	environ_free_envp(env);
+
+	n = 0;
+	for (layer = env; layer != NULL; layer = layer->parent) {
+		RB_FOREACH(envent, environ_tree, &layer->tree)
+			n++;
+	}
+	list = xcalloc(n + 1, sizeof *list);
+
+	n = 0;
+	for (layer = env; layer != NULL; layer = layer->parent) {
+		RB_FOREACH(envent, environ_tree, &layer->tree) {
+			if (envent->value == NULL)
+				continue;
+			if (environ_hidden(env, layer, envent->name))
+				continue;
+			list[n++] = envent;
+		}
+	}
+	qsort(list, n, sizeof *list, environ_sort_cmp);
+
+	env->envp = xcalloc(n + 1, sizeof *env->envp);
+	for (i = 0; i < n; i++) {
+		xasprintf(&env->envp[i], "%s=%s", list[i]->name,
+		    list[i]->value);
+	}
+	env->envp[n] = NULL;
+	xfree(list);
+
+	env->envp_generation = generation;
+	return (env->envp);
+}
+
+/*
+ * Push environment into the real environment - use after fork(). The
+ * parent's list is used as it is, so it should be built before fork() to be
+ * kept for the next process.
+ */
 void
 environ_push(struct environ *env)
 {
-	ARRAY_DECL(, char *)	varlist;
-	struct environ_entry   *envent;
-	char		      **varp, *var;
-	u_int			i;
-
-	ARRAY_INIT(&varlist);
-	for (varp = environ; *varp != NULL; varp++) {
-		var = xstrdup(*varp);
-		var[strcspn(var, "=")] = '\0';
-		ARRAY_ADD(&varlist, var);
-	}
-	for (i = 0; i < ARRAY_LENGTH(&varlist); i++)
-		unsetenv(ARRAY_ITEM(&varlist, i));
-	ARRAY_FREE(&varlist);
+	struct environ_entry	*envent;
 
-	RB_FOREACH(envent, environ, env) {
+	if (env->parent != NULL)
+		environ = environ_envp(env->parent);
+	else
+		environ = xcalloc(1, sizeof *environ);
+
+	RB_FOREACH(envent, environ_tree, &env->tree) {
 		if (envent->value != NULL)
 			setenv(envent->name, envent->value, 1);
+		else
+			unsetenv(envent->name);
 	}
 }
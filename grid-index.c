@@ -0,0 +1,329 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+
+#include <string.h>
+
+#include "tmux.h"
+
+/*
+ * Trigram index of grid history, used to find the lines which may contain a
+ * plain string without looking at every line.
+ *
+ * Each run of three bytes in a line is hashed to one of GRID_INDEX_SIZE
+ * lists and the line's absolute number added to the list. Lines are added
+ * when they scroll into the history and never change after that, so the
+ * lists stay in order. Hashing means a list may name lines which do not
+ * contain a trigram, so lines found must still be checked, but a line not
+ * on every list for a string cannot contain it.
+ */
+
+/* Maximum number of trigrams of a search string looked up. */
+#define GRID_INDEX_KEYS 16
+
+u_int	grid_index_hash(const u_char *);
+void	grid_index_add(struct grid_index_list *, u_int);
+void	grid_index_line(struct grid *, u_int);
+u_int	grid_index_find(struct grid_index_list *, u_int);
+int	grid_index_contains(struct grid_index_list *, u_int);
+
+/* Hash three bytes to a list. */
+u_int
+grid_index_hash(const u_char *ptr)
+{
+	u_int	key;
+
+	key = ((u_int) ptr[0] << 16) | ((u_int) ptr[1] << 8) | ptr[2];
+	return ((key * 2654435761U) >> (32 - GRID_INDEX_BITS));
+}
+
+/* Add a line to a list, unless it is already the last entry. */
+void
+grid_index_add(struct grid_index_list *gil, u_int line)
+{
+	if (gil->num != gil->first && gil->list[gil->num - 1] == line)
+		return;
+
+	if (gil->num == gil->space) {
+		if (gil->first != 0) {
+			memmove(gil->list, gil->list + gil->first,
+			    (gil->num - gil->first) * sizeof *gil->list);
+			gil->num -= gil->first;
+			gil->first = 0;
+		}
+		if (gil->num == gil->space) {
+			gil->space = gil->space == 0 ? 16 : gil->space * 2;
+			gil->list = xrealloc(
+			    gil->list, gil->space, sizeof *gil->list);
+		}
+	}
+	gil->list[gil->num++] = line;
+}
+
+/* Add the trigrams in a history line to the index. */
+void
+grid_index_line(struct grid *gd, u_int py)
+{
+	struct grid_index	*gi = gd->index;
+	const u_char		*ptr;
+	size_t			 len, i;
+	u_int			 line;
+
+	len = grid_string_line(gd, py, &gi->buf, NULL, &gi->bufsize);
+	if (len < 3)
+		return;
+
+	line = gd->hcollected + py;
+	ptr = gi->buf;
+	for (i = 0; i < len - 2; i++)
+		grid_index_add(&gi->lists[grid_index_hash(ptr + i)], line);
+}
+
+/* Create an index of the existing history of a grid. */
+void
+grid_index_create(struct grid *gd)
+{
+	gd->index = xcalloc(1, sizeof *gd->index);
+	gd->index->next = gd->hcollected;
+
+	grid_index_update(gd);
+}
+
+/* Free the index. */
+void
+grid_index_destroy(struct grid *gd)
+{
+	struct grid_index	*gi = gd->index;
+	u_int			 i;
+
+	for (i = 0; i < GRID_INDEX_SIZE; i++) {
+		if (gi->lists[i].list != NULL)
+			xfree(gi->lists[i].list);
+	}
+	if (gi->buf != NULL)
+		xfree(gi->buf);
+	xfree(gi);
+
+	gd->index = NULL;
+}
+
+/* Index any lines added to the history since the last update. */
+void
+grid_index_update(struct grid *gd)
+{
+	struct grid_index	*gi = gd->index;
+	u_int			 end;
+
+	if (gi->next < gd->hcollected)
+		gi->next = gd->hcollected;
+
+	end = gd->hcollected + gd->hsize;
+	for (; gi->next < end; gi->next++)
+		grid_index_line(gd, gi->next - gd->hcollected);
+}
+
+/* Drop lines which have been collected from the top of the history. */
+void
+grid_index_collect(struct grid *gd)
+{
+	struct grid_index	*gi = gd->index;
+	struct grid_index_list	*gil;
+	u_int			 i;
+
+	for (i = 0; i < GRID_INDEX_SIZE; i++) {
+		gil = &gi->lists[i];
+		gil->first = grid_index_find(gil, gd->hcollected);
+		if (gil->first == gil->num)
+			gil->first = gil->num = 0;
+	}
+}
+
+/*
+ * Drop lines which are no longer in the history because it has been made
+ * smaller; they are indexed again if they go back into it.
+ */
+void
+grid_index_truncate(struct grid *gd)
+{
+	struct grid_index	*gi = gd->index;
+	u_int			 end, i;
+
+	end = gd->hcollected + gd->hsize;
+	if (gi->next <= end)
+		return;
+
+	for (i = 0; i < GRID_INDEX_SIZE; i++)
+		gi->lists[i].num = grid_index_find(&gi->lists[i], end);
+	gi->next = end;
+}
+
+/* Find the position of the first line in a list at or after a line. */
+u_int
+grid_index_find(struct grid_index_list *gil, u_int line)
+{
+	u_int	lo, hi, mid;
+
+	lo = gil->first;
+	hi = gil->num;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (gil->list[mid] < line)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo);
+}
+
+/* Is a line in a list? */
+int
+grid_index_contains(struct grid_index_list *gil, u_int line)
+{
+	u_int	idx;
+
+	idx = grid_index_find(gil, line);
+	return (idx != gil->num && gil->list[idx] == line);
+}
+
+/*
+ * Work out the trigrams to look up for a string, keeping those with the
+ * fewest lines. Returns -1 if it is too short to use the index, or if it is
+ * so common that checking each line against the index would be slower than
+ * looking at all of them.
+ */
+int
+grid_index_query_init(struct grid *gd,
+    struct grid_index_query *gq, const char *s, size_t len)
+{
+	struct grid_index	*gi = gd->index;
+	u_int			 key, i, j, n, *keys, *sizes;
+
+	gq->keys = NULL;
+	gq->nkeys = 0;
+	if (len < 3)
+		return (-1);
+
+	keys = xcalloc(len - 2, sizeof *keys);
+	sizes = xcalloc(len - 2, sizeof *sizes);
+	n = 0;
+	for (i = 0; i < len - 2; i++) {
+		key = grid_index_hash((const u_char *) s + i);
+		for (j = 0; j < n; j++) {
+			if (keys[j] == key)
+				break;
+		}
+		if (j != n)
+			continue;
+		keys[n] = key;
+		sizes[n] = gi->lists[key].num - gi->lists[key].first;
+		n++;
+	}
+
+	/* Pick the smallest lists. */
+	gq->keys = xcalloc(GRID_INDEX_KEYS, sizeof *gq->keys);
+	while (gq->nkeys < GRID_INDEX_KEYS && gq->nkeys < n) {
+		for (i = j = gq->nkeys; i < n; i++) {
+			if (sizes[i] < sizes[j])
+				j = i;
+		}
+		key = keys[j];
+		keys[j] = keys[gq->nkeys];
+		sizes[j] = sizes[gq->nkeys];
+		keys[gq->nkeys] = key;
+		sizes[gq->nkeys] = gi->lists[key].num - gi->lists[key].first;
+		gq->keys[gq->nkeys++] = key;
+	}
+	j = sizes[0];
+
+	xfree(keys);
+	xfree(sizes);
+
+	if (j > gd->hsize / 4) {
+		grid_index_query_free(gq);
+		return (-1);
+	}
+	return (0);
+}
+
+/* Free a query. */
+void
+grid_index_query_free(struct grid_index_query *gq)
+{
+	if (gq->keys != NULL)
+		xfree(gq->keys);
+	gq->keys = NULL;
+}
+
+/*
+ * Find the next history line, starting at py and moving up or down, which
+ * may contain the string. Returns -1 if there is none.
+ */
+int
+grid_index_next(struct grid *gd,
+    struct grid_index_query *gq, u_int py, int up, u_int *next)
+{
+	struct grid_index	*gi = gd->index;
+	struct grid_index_list	*gil, *try;
+	u_int			 line, end, idx, i;
+
+	if (py >= gd->hsize)
+		return (-1);
+	line = gd->hcollected + py;
+	end = gd->hcollected + gd->hsize;
+
+	/* Walk the shortest list and check each line is on all the others. */
+	gil = &gi->lists[gq->keys[0]];
+	for (i = 1; i < gq->nkeys; i++) {
+		try = &gi->lists[gq->keys[i]];
+		if (try->num - try->first < gil->num - gil->first)
+			gil = try;
+	}
+
+	idx = grid_index_find(gil, line);
+	if (up) {
+		if (idx == gil->num || gil->list[idx] != line) {
+			if (idx == gil->first)
+				return (-1);
+			idx--;
+		}
+	}
+
+	for (;;) {
+		if (idx == gil->num || gil->list[idx] >= end)
+			return (-1);
+		line = gil->list[idx];
+
+		for (i = 0; i < gq->nkeys; i++) {
+			try = &gi->lists[gq->keys[i]];
+			if (try != gil && !grid_index_contains(try, line))
+				break;
+		}
+		if (i == gq->nkeys) {
+			*next = line - gd->hcollected;
+			return (0);
+		}
+
+		if (up) {
+			if (idx == gil->first)
+				return (-1);
+			idx--;
+		} else
+			idx++;
+	}
+}
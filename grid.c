@@ -82,9 +82,12 @@ grid_create(u_int sx, u_int sy, u_int hlimit)
 
 	gd->hsize = 0;
 	gd->hlimit = hlimit;
+	gd->hcollected = 0;
 
 	gd->linedata = xcalloc(gd->sy, sizeof *gd->linedata);
 
+	gd->index = NULL;
+
 	return (gd);
 }
 
@@ -105,6 +108,9 @@ grid_destroy(struct grid *gd)
 
 	xfree(gd->linedata);
 
+	if (gd->index != NULL)
+		grid_index_destroy(gd);
+
 	xfree(gd);
 }
 
@@ -162,6 +168,10 @@ grid_collect_history(struct grid *gd)
 
 	grid_move_lines(gd, 0, yy, gd->hsize + gd->sy - yy);
 	gd->hsize -= yy;
+	gd->hcollected += yy;
+
+	if (gd->index != NULL)
+		grid_index_collect(gd);
 }
 
 /*
@@ -180,6 +190,9 @@ grid_scroll_history(struct grid *gd)
 	memset(&gd->linedata[yy], 0, sizeof gd->linedata[yy]);
 
 	gd->hsize++;
+
+	if (gd->index != NULL)
+		grid_index_update(gd);
 }
 
 /* Scroll a region up, moving the top line into the history. */
@@ -214,6 +227,9 @@ grid_scroll_history_region(struct grid *gd, u_int upper, u_int lower)
 
 	/* Move the history offset down over the line. */
 	gd->hsize++;
+
+	if (gd->index != NULL)
+		grid_index_update(gd);
 }
 
 /* Expand line to fit to cell. */
@@ -457,6 +473,24 @@ grid_move_cells(struct grid *gd, u_int dx, u_int px, u_int py, u_int nx)
 /* Convert cells into a string. */
 char *
 grid_string_cells(struct grid *gd, u_int px, u_int py, u_int nx)
+{
+	char	*buf;
+	size_t	 len;
+
+	buf = NULL;
+	len = 0;
+	grid_string_cells_buffer(gd, px, py, nx, &buf, &len);
+	return (buf);
+}
+
+/*
+ * Convert cells into a string in a buffer of size *lenp, which is allocated
+ * or grown as needed so it may be reused for many lines. Returns the length
+ * of the string.
+ */
+size_t
+grid_string_cells_buffer(
+    struct grid *gd, u_int px, u_int py, u_int nx, char **bufp, size_t *lenp)
 {
 	const struct grid_cell	*gc;
 	const struct grid_utf8	*gu;
@@ -466,8 +500,12 @@ grid_string_cells(struct grid *gd, u_int px, u_int py, u_int nx)
 
 	GRID_DEBUG(gd, "px=%u, py=%u, nx=%u", px, py, nx);
 
-	len = 128;
-	buf = xmalloc(len);
+	buf = *bufp;
+	len = *lenp;
+	if (buf == NULL) {
+		len = 128;
+		buf = xmalloc(len);
+	}
 	off = 0;
 
 	for (xx = px; xx < px + nx; xx++) {
@@ -498,7 +536,59 @@ grid_string_cells(struct grid *gd, u_int px, u_int py, u_int nx)
 	while (off > 0 && buf[off - 1] == ' ')
 		off--;
 	buf[off] = '\0';
-	return (buf);
+
+	*bufp = buf;
+	*lenp = len;
+	return (off);
+}
+
+/*
+ * Convert a whole line to a string of bytes, stopping at the last cell used
+ * but not removing trailing spaces. If colsp is not NULL, it is filled with
+ * the cell each byte came from, plus the line size after the last byte.
+ */
+size_t
+grid_string_line(
+    struct grid *gd, u_int py, char **bufp, u_int **colsp, size_t *sizep)
+{
+	struct grid_line	*gl = &gd->linedata[py];
+	const struct grid_cell	*gc;
+	const struct grid_utf8	*gu;
+	size_t			 off, size, i;
+	u_int			 xx;
+
+	if (*sizep < (gl->cellsize * UTF8_SIZE) + 1) {
+		*sizep = (gl->cellsize * UTF8_SIZE) + 1;
+		*bufp = xrealloc(*bufp, 1, *sizep);
+		if (colsp != NULL)
+			*colsp = xrealloc(*colsp, *sizep, sizeof **colsp);
+	}
+
+	off = 0;
+	for (xx = 0; xx < gl->cellsize; xx++) {
+		gc = &gl->celldata[xx];
+		if (gc->flags & GRID_FLAG_PADDING)
+			continue;
+
+		if (gc->flags & GRID_FLAG_UTF8) {
+			gu = &gl->utf8data[xx];
+			size = grid_utf8_copy(gu, *bufp + off, UTF8_SIZE);
+			if (colsp != NULL) {
+				for (i = 0; i < size; i++)
+					(*colsp)[off + i] = xx;
+			}
+			off += size;
+		} else {
+			if (colsp != NULL)
+				(*colsp)[off] = xx;
+			(*bufp)[off++] = gc->data;
+		}
+	}
+	(*bufp)[off] = '\0';
+	if (colsp != NULL)
+		(*colsp)[off] = gl->cellsize;
+
+	return (off);
 }
 
 /*
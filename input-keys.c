@@ -150,9 +150,9 @@ input_key(struct window_pane *wp, int key)
 	 */
 	if (key != KEYC_NONE && (key & ~KEYC_ESCAPE) < 0x100) {
 		if (key & KEYC_ESCAPE)
-			bufferevent_write(wp->event, "\033", 1);
+			window_pane_write(wp, "\033", 1);
 		ch = key & ~KEYC_ESCAPE;
-		bufferevent_write(wp->event, &ch, 1);
+		window_pane_write(wp, &ch, 1);
 		return;
 	}
 
@@ -162,7 +162,7 @@ input_key(struct window_pane *wp, int key)
 	 */
 	if (options_get_number(&wp->window->options, "xterm-keys")) {
 		if ((out = xterm_keys_lookup(key)) != NULL) {
-			bufferevent_write(wp->event, out, strlen(out));
+			window_pane_write(wp, out, strlen(out));
 			xfree(out);
 			return;
 		}
@@ -193,8 +193,8 @@ input_key(struct window_pane *wp, int key)
 
 	/* Prefix a \033 for escape. */
 	if (key & KEYC_ESCAPE)
-		bufferevent_write(wp->event, "\033", 1);
-	bufferevent_write(wp->event, ike->data, dlen);
+		window_pane_write(wp, "\033", 1);
+	window_pane_write(wp, ike->data, dlen);
 }
 
 /* Translate mouse and output. */
@@ -218,7 +218,7 @@ input_mouse(struct window_pane *wp, struct mouse_event *m)
 			buf[len++] = m->x + 33;
 			buf[len++] = m->y + 33;
 		}
-		bufferevent_write(wp->event, buf, len);
+		window_pane_write(wp, buf, len);
 	} else if ((m->b & MOUSE_BUTTON) != MOUSE_2) {
 		if (options_get_number(&wp->window->options, "mode-mouse") &&
 		    window_pane_set_mode(wp, &window_copy_mode) == 0) {
@@ -705,6 +705,8 @@ input_parse(struct window_pane *wp)
 
 	wp->window->flags |= WINDOW_ACTIVITY;
 	wp->window->flags &= ~WINDOW_SILENCE;
+	server_window_dirty(wp->window);
+	queue_window_name(wp->window);
 
 	/*
 	 * Open the screen. Use NULL wp if there is a mode set as don't want to
@@ -819,7 +821,7 @@ input_reply(struct input_ctx *ictx, const char *fmt, ...)
 	vasprintf(&reply, fmt, ap);
 	va_end(ap);
 
-	bufferevent_write(ictx->wp->event, reply, strlen(reply));
+	window_pane_write(ictx->wp, reply, strlen(reply));
 	xfree(reply);
 }
 
@@ -906,6 +908,7 @@ input_c0_dispatch(struct input_ctx *ictx)
 		break;
 	case '\007':	/* BEL */
 		wp->window->flags |= WINDOW_BELL;
+		server_window_dirty(wp->window);
 		break;
 	case '\010':	/* BS */
 		screen_write_backspace(sctx);
@@ -1188,6 +1191,9 @@ input_csi_dispatch(struct input_ctx *ictx)
 		case 1005:
 			screen_write_utf8mousemode(&ictx->ctx, 0);
 			break;
+		case 2004:
+			screen_write_bracketpaste(&ictx->ctx, 0);
+			break;
 		case 1049:
 			window_pane_alternate_off(wp, &ictx->cell);
 			break;
@@ -1235,6 +1241,9 @@ input_csi_dispatch(struct input_ctx *ictx)
 		case 1005:
 			screen_write_utf8mousemode(&ictx->ctx, 1);
 			break;
+		case 2004:
+			screen_write_bracketpaste(&ictx->ctx, 1);
+			break;
 		case 1049:
 			window_pane_alternate_on(wp, &ictx->cell);
 			break;
@@ -48,8 +48,6 @@ job_run(const char *cmd,
 	if (socketpair(AF_UNIX, SOCK_STREAM, PF_UNSPEC, out) != 0)
 		return (NULL);
 
-	environ_init(&env);
-	environ_copy(&global_environ, &env);
 	server_fill_environ(NULL, &env);
 
 	switch (pid = fork()) {
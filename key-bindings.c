@@ -26,8 +26,14 @@
 
 SPLAY_GENERATE(key_bindings, key_binding, entry, key_bindings_cmp);
 
+/*
+ * Key bindings are kept in a tree, which is used to list them, and in a table
+ * indexed by key slot (one half for keys after the prefix and one for keys
+ * without), which is used to find them.
+ */
 struct key_bindings	key_bindings;
 struct key_bindings	dead_key_bindings;
+struct key_binding     *key_bindings_index[2][KEYC_NSLOTS];
 
 int
 key_bindings_cmp(struct key_binding *bd1, struct key_binding *bd2)
@@ -46,10 +52,41 @@ key_bindings_cmp(struct key_binding *bd1, struct key_binding *bd2)
 	return (0);
 }
 
+/*
+ * Find the slot for a key in a table indexed by key, ignoring the prefix
+ * flag. Returns -1 if the key has no slot.
+ */
+int
+key_bindings_slot(int key)
+{
+	int	base, slot;
+
+	base = key & KEYC_MASK_KEY;
+	if (base >= KEYC_BASE && base <= KEYC_KP_PERIOD)
+		slot = 256 + base - KEYC_BASE;
+	else if (base >= 0 && base <= 255)
+		slot = base;
+	else
+		return (-1);
+
+	slot *= 8;
+	if (key & KEYC_ESCAPE)
+		slot |= 1;
+	if (key & KEYC_CTRL)
+		slot |= 2;
+	if (key & KEYC_SHIFT)
+		slot |= 4;
+	return (slot);
+}
+
 struct key_binding *
 key_bindings_lookup(int key)
 {
 	struct key_binding	bd;
+	int			slot;
+
+	if ((slot = key_bindings_slot(key)) != -1)
+		return (key_bindings_index[!!(key & KEYC_PREFIX)][slot]);
 
 	bd.key = key;
 	return (SPLAY_FIND(key_bindings, &key_bindings, &bd));
@@ -59,12 +96,15 @@ void
 key_bindings_add(int key, int can_repeat, struct cmd_list *cmdlist)
 {
 	struct key_binding	*bd;
+	int			 slot;
 
 	key_bindings_remove(key);
 
 	bd = xmalloc(sizeof *bd);
 	bd->key = key;
 	SPLAY_INSERT(key_bindings, &key_bindings, bd);
+	if ((slot = key_bindings_slot(key)) != -1)
+		key_bindings_index[!!(key & KEYC_PREFIX)][slot] = bd;
 
 	bd->can_repeat = can_repeat;
 	bd->cmdlist = cmdlist;
@@ -74,10 +114,13 @@ void
 key_bindings_remove(int key)
 {
 	struct key_binding	*bd;
+	int			 slot;
 
 	if ((bd = key_bindings_lookup(key)) == NULL)
 		return;
 	SPLAY_REMOVE(key_bindings, &key_bindings, bd);
+	if ((slot = key_bindings_slot(key)) != -1)
+		key_bindings_index[!!(key & KEYC_PREFIX)][slot] = NULL;
 	SPLAY_INSERT(key_bindings, &dead_key_bindings, bd);
 }
 
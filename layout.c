@@ -216,6 +216,8 @@ layout_fix_panes(struct window *w, u_int wsx, u_int wsy)
 
 		window_pane_resize(wp, sx, sy);
 	}
+
+	control_notify_layout(w);
 }
 
 /* Count the number of available cells in a layout. */
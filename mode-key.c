@@ -31,7 +31,9 @@
  *
  * The fixed tables of struct mode_key_entry below are the defaults: they are
  * built into a tree of struct mode_key_binding by mode_key_init_trees, which
- * can then be modified.
+ * can then be modified. The tree is used to list the bindings; keys are
+ * looked up in a table indexed by key slot, which is kept up to date by
+ * mode_key_add and mode_key_remove.
  *
  * vi command mode is handled by having a mode flag in the struct which allows
  * two sets of bindings to be swapped between. A couple of editing commands
@@ -158,6 +160,7 @@ const struct mode_key_entry mode_key_vi_edit[] = {
 	{ 0,		       -1, 0 }
 };
 struct mode_key_tree mode_key_tree_vi_edit;
+struct mode_key_index mode_key_index_vi_edit;
 
 /* vi choice selection keys. */
 const struct mode_key_entry mode_key_vi_choice[] = {
@@ -180,6 +183,7 @@ const struct mode_key_entry mode_key_vi_choice[] = {
 	{ 0,			-1, 0 }
 };
 struct mode_key_tree mode_key_tree_vi_choice;
+struct mode_key_index mode_key_index_vi_choice;
 
 /* vi copy mode keys. */
 const struct mode_key_entry mode_key_vi_copy[] = {
@@ -248,6 +252,7 @@ const struct mode_key_entry mode_key_vi_copy[] = {
 	{ 0,			-1, 0 }
 };
 struct mode_key_tree mode_key_tree_vi_copy;
+struct mode_key_index mode_key_index_vi_copy;
 
 /* emacs editing keys. */
 const struct mode_key_entry mode_key_emacs_edit[] = {
@@ -278,6 +283,7 @@ const struct mode_key_entry mode_key_emacs_edit[] = {
 	{ 0,		       -1, 0 }
 };
 struct mode_key_tree mode_key_tree_emacs_edit;
+struct mode_key_index mode_key_index_emacs_edit;
 
 /* emacs choice selection keys. */
 const struct mode_key_entry mode_key_emacs_choice[] = {
@@ -299,6 +305,7 @@ const struct mode_key_entry mode_key_emacs_choice[] = {
 	{ 0,			-1, 0 }
 };
 struct mode_key_tree mode_key_tree_emacs_choice;
+struct mode_key_index mode_key_index_emacs_choice;
 
 /* emacs copy mode keys. */
 const struct mode_key_entry mode_key_emacs_copy[] = {
@@ -360,23 +367,30 @@ const struct mode_key_entry mode_key_emacs_copy[] = {
 	{ 0,			-1, 0 }
 };
 struct mode_key_tree mode_key_tree_emacs_copy;
+struct mode_key_index mode_key_index_emacs_copy;
 
 /* Table mapping key table names to default settings and trees. */
 const struct mode_key_table mode_key_tables[] = {
 	{ "vi-edit", mode_key_cmdstr_edit,
-	  &mode_key_tree_vi_edit, mode_key_vi_edit },
+	  &mode_key_tree_vi_edit, &mode_key_index_vi_edit,
+	  mode_key_vi_edit },
 	{ "vi-choice", mode_key_cmdstr_choice,
-	  &mode_key_tree_vi_choice, mode_key_vi_choice },
+	  &mode_key_tree_vi_choice, &mode_key_index_vi_choice,
+	  mode_key_vi_choice },
 	{ "vi-copy", mode_key_cmdstr_copy,
-	  &mode_key_tree_vi_copy, mode_key_vi_copy },
+	  &mode_key_tree_vi_copy, &mode_key_index_vi_copy,
+	  mode_key_vi_copy },
 	{ "emacs-edit", mode_key_cmdstr_edit,
-	  &mode_key_tree_emacs_edit, mode_key_emacs_edit },
+	  &mode_key_tree_emacs_edit, &mode_key_index_emacs_edit,
+	  mode_key_emacs_edit },
 	{ "emacs-choice", mode_key_cmdstr_choice,
-	  &mode_key_tree_emacs_choice, mode_key_emacs_choice },
+	  &mode_key_tree_emacs_choice, &mode_key_index_emacs_choice,
+	  mode_key_emacs_choice },
 	{ "emacs-copy", mode_key_cmdstr_copy,
-	  &mode_key_tree_emacs_copy, mode_key_emacs_copy },
+	  &mode_key_tree_emacs_copy, &mode_key_index_emacs_copy,
+	  mode_key_emacs_copy },
 
-	{ NULL, NULL, NULL, NULL }
+	{ NULL, NULL, NULL, NULL, NULL }
 };
 
 SPLAY_GENERATE(mode_key_tree, mode_key_binding, entry, mode_key_cmp);
@@ -426,24 +440,66 @@ mode_key_init_trees(void)
 {
 	const struct mode_key_table	*mtab;
 	const struct mode_key_entry	*ment;
-	struct mode_key_binding		*mbind;
 
 	for (mtab = mode_key_tables; mtab->name != NULL; mtab++) {
 		SPLAY_INIT(mtab->tree);
-		for (ment = mtab->table; ment->mode != -1; ment++) {
-			mbind = xmalloc(sizeof *mbind);
-			mbind->key = ment->key;
-			mbind->mode = ment->mode;
-			mbind->cmd = ment->cmd;
-			SPLAY_INSERT(mode_key_tree, mtab->tree, mbind);
-		}
+		memset(mtab->index, 0, sizeof *mtab->index);
+		for (ment = mtab->table; ment->mode != -1; ment++)
+			mode_key_add(mtab, ment->key, ment->mode, ment->cmd);
 	}
 }
 
+/* Bind a key in a table, replacing any existing binding. */
+void
+mode_key_add(const struct mode_key_table *mtab, int key, int mode,
+    enum mode_key_cmd cmd)
+{
+	struct mode_key_binding	*mbind, mtmp;
+	int			 slot;
+
+	mtmp.key = key;
+	mtmp.mode = mode;
+	if ((mbind = SPLAY_FIND(mode_key_tree, mtab->tree, &mtmp)) == NULL) {
+		mbind = xmalloc(sizeof *mbind);
+		mbind->key = key;
+		mbind->mode = mode;
+		SPLAY_INSERT(mode_key_tree, mtab->tree, mbind);
+	}
+	mbind->cmd = cmd;
+
+	if ((slot = key_bindings_slot(key)) != -1)
+		mtab->index->cmd[mode][slot] = cmd;
+}
+
+/* Remove the binding for a key from a table. */
+void
+mode_key_remove(const struct mode_key_table *mtab, int key, int mode)
+{
+	struct mode_key_binding	*mbind, mtmp;
+	int			 slot;
+
+	mtmp.key = key;
+	mtmp.mode = mode;
+	if ((mbind = SPLAY_FIND(mode_key_tree, mtab->tree, &mtmp)) == NULL)
+		return;
+	SPLAY_REMOVE(mode_key_tree, mtab->tree, mbind);
+	xfree(mbind);
+
+	if ((slot = key_bindings_slot(key)) != -1)
+		mtab->index->cmd[mode][slot] = MODEKEY_NONE;
+}
+
 void
 mode_key_init(struct mode_key_data *mdata, struct mode_key_tree *mtree)
 {
+	const struct mode_key_table	*mtab;
+
 	mdata->tree = mtree;
+	mdata->index = NULL;
+	for (mtab = mode_key_tables; mtab->name != NULL; mtab++) {
+		if (mtab->tree == mtree)
+			mdata->index = mtab->index;
+	}
 	mdata->mode = 0;
 }
 
@@ -451,21 +507,29 @@ enum mode_key_cmd
 mode_key_lookup(struct mode_key_data *mdata, int key)
 {
 	struct mode_key_binding	*mbind, mtmp;
-
-	mtmp.key = key;
-	mtmp.mode = mdata->mode;
-	if ((mbind = SPLAY_FIND(mode_key_tree, mdata->tree, &mtmp)) == NULL) {
+	enum mode_key_cmd	 cmd;
+	int			 slot;
+
+	if ((slot = key_bindings_slot(key)) != -1)
+		cmd = mdata->index->cmd[mdata->mode][slot];
+	else {
+		mtmp.key = key;
+		mtmp.mode = mdata->mode;
+		mbind = SPLAY_FIND(mode_key_tree, mdata->tree, &mtmp);
+		cmd = mbind != NULL ? mbind->cmd : MODEKEY_NONE;
+	}
+	if (cmd == MODEKEY_NONE) {
 		if (mdata->mode != 0)
 			return (MODEKEY_NONE);
 		return (MODEKEY_OTHER);
 	}
 
-	switch (mbind->cmd) {
+	switch (cmd) {
 	case MODEKEYEDIT_SWITCHMODE:
 	case MODEKEYEDIT_SWITCHMODEAPPEND:
 		mdata->mode = 1 - mdata->mode;
 		/* FALLTHROUGH */
 	default:
-		return (mbind->cmd);
+		return (cmd);
 	}
 }
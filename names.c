@@ -26,31 +26,88 @@
 #include "tmux.h"
 
 void	 window_name_callback(unused int, unused short, void *);
+void	 window_name_schedule(void);
+void	 window_name_check(struct window *);
 char	*parse_window_name(const char *);
 
+/* One timer for all windows waiting to have their names checked. */
+struct event	 name_timer;
+TAILQ_HEAD(, window) name_windows = TAILQ_HEAD_INITIALIZER(name_windows);
+
+/*
+ * Queue a window to have its name checked. This is called when something may
+ * have changed the foreground process (output, a different active pane, a
+ * mode or the pane dying). The window is then checked on the next few sweeps
+ * of the name timer, to give a new process a chance to start; windows which
+ * have not changed are not looked at at all.
+ */
 void
 queue_window_name(struct window *w)
+{
+	if (w->name_checks == 0)
+		TAILQ_INSERT_TAIL(&name_windows, w, name_entry);
+	w->name_checks = NAME_CHECKS;
+	window_name_schedule();
+}
+
+/* Take a window off the queue, if it is on it. */
+void
+unqueue_window_name(struct window *w)
+{
+	if (w->name_checks == 0)
+		return;
+	TAILQ_REMOVE(&name_windows, w, name_entry);
+	w->name_checks = 0;
+}
+
+/* Start the name timer if it isn't already running. */
+void
+window_name_schedule(void)
 {
 	struct timeval	tv;
 
+	if (evtimer_initialized(&name_timer) &&
+	    evtimer_pending(&name_timer, NULL))
+		return;
+
 	tv.tv_sec = 0;
 	tv.tv_usec = NAME_INTERVAL * 1000L;
 
-	evtimer_del(&w->name_timer);
-	evtimer_set(&w->name_timer, window_name_callback, w);
-	evtimer_add(&w->name_timer, &tv);
+	evtimer_set(&name_timer, window_name_callback, NULL);
+	evtimer_add(&name_timer, &tv);
 }
 
+/* Check every queued window and restart the timer if any are left. */
 /* ARGSUSED */
 void
-window_name_callback(unused int fd, unused short events, void *data)
+window_name_callback(unused int fd, unused short events, unused void *data)
 {
-	struct window	*w = data;
-	char		*name, *wname;
+	struct window	*w, *next_w;
 
-	queue_window_name(w);	/* XXX even if the option is off? */
-	if (!options_get_number(&w->options, "automatic-rename"))
-		return;
+	next_w = TAILQ_FIRST(&name_windows);
+	while (next_w != NULL) {
+		w = next_w;
+		next_w = TAILQ_NEXT(w, name_entry);
+
+		if (--w->name_checks == 0)
+			TAILQ_REMOVE(&name_windows, w, name_entry);
+
+		if (w->active == NULL || w->name == NULL)
+			continue;
+		if (!options_get_number(&w->options, "automatic-rename"))
+			continue;
+		window_name_check(w);
+	}
+
+	if (!TAILQ_EMPTY(&name_windows))
+		window_name_schedule();
+}
+
+/* Update the window name from its active pane. */
+void
+window_name_check(struct window *w)
+{
+	char	*name, *wname;
 
 	if (w->active->screen != &w->active->base)
 		name = NULL;
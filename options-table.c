@@ -26,11 +26,26 @@
  * This file has a tables with all the server, session and window
  * options. These tables are the master copy of the options with their real
  * (user-visible) types, range limits and default values. At start these are
- * copied into the runtime global options trees (which only has number and
+ * copied into the runtime global options (which only have number and
  * string types). These tables are then used to loop up the real type when
  * the user sets an option or its value needs to be shown.
+ *
+ * Each option also has a slot number, its position in the server, session
+ * and window tables taken in that order, which is used to find it in a
+ * struct options. Names are mapped to slots with a small hash table built
+ * the first time one is looked up.
  */
 
+/* Size of the name hash table, a power of two at least twice the options. */
+#define OPTIONS_TABLE_HASHSIZE 256
+
+void	options_table_build(void);
+u_int	options_table_hash(const char *);
+
+u_int	options_table_nslots;
+const struct options_table_entry *options_table_slots[OPTIONS_TABLE_HASHSIZE];
+u_short	options_table_names[OPTIONS_TABLE_HASHSIZE];
+
 /* Choice option type lists. */
 const char *options_table_mode_keys_list[] = {
 	"emacs", "vi", NULL
@@ -442,6 +457,11 @@ const struct options_table_entry window_options_table[] = {
 	  .default_num = 0
 	},
 
+	{ .name = "history-index",
+	  .type = OPTIONS_TABLE_FLAG,
+	  .default_num = 0
+	},
+
 	{ .name = "main-pane-height",
 	  .type = OPTIONS_TABLE_NUMBER,
 	  .minimum = 1,
@@ -482,6 +502,11 @@ const struct options_table_entry window_options_table[] = {
 	  .default_num = 0
 	},
 
+	{ .name = "mode-search-regex",
+	  .type = OPTIONS_TABLE_FLAG,
+	  .default_num = 0
+	},
+
 	{ .name = "monitor-activity",
 	  .type = OPTIONS_TABLE_FLAG,
 	  .default_num = 0
@@ -596,6 +621,73 @@ const struct options_table_entry window_options_table[] = {
 	{ .name = NULL }
 };
 
+/*
+ * Hash an option name. Names are short and many share a prefix or suffix, so
+ * this mixes the length with a few bytes from the start, middle and end
+ * rather than every byte.
+ */
+u_int
+options_table_hash(const char *name)
+{
+	const u_char	*ptr = name;
+	size_t		 len;
+	u_int		 h;
+
+	len = strlen(name);
+	if (len < 2)
+		return (len);
+	h = len * 2654435761U;
+	h ^= ptr[0] << 3;
+	h ^= ptr[len / 2] * 668265263U;
+	h ^= ptr[len - 2] * 3266489909U;
+	h ^= ptr[len - 1] * 2246822507U;
+	return ((h >> 8) & (OPTIONS_TABLE_HASHSIZE - 1));
+}
+
+/* Number the options and build the name hash table. */
+void
+options_table_build(void)
+{
+	static const struct options_table_entry	*tables[] = {
+		server_options_table,
+		session_options_table,
+		window_options_table
+	};
+	const struct options_table_entry	*oe;
+	u_int					 i, h;
+
+	for (i = 0; i < nitems(tables); i++) {
+		for (oe = tables[i]; oe->name != NULL; oe++) {
+			if (options_table_nslots >= OPTIONS_TABLE_HASHSIZE / 2)
+				fatalx("too many options");
+			options_table_slots[options_table_nslots++] = oe;
+
+			h = options_table_hash(oe->name);
+			while (options_table_names[h] != 0)
+				h = (h + 1) & (OPTIONS_TABLE_HASHSIZE - 1);
+			options_table_names[h] = options_table_nslots;
+		}
+	}
+}
+
+/* Find the slot of an option by name. Returns -1 if there is no option. */
+int
+options_table_slot(const char *name)
+{
+	u_int	h, slot;
+
+	if (options_table_nslots == 0)
+		options_table_build();
+
+	h = options_table_hash(name);
+	while ((slot = options_table_names[h]) != 0) {
+		if (strcmp(options_table_slots[slot - 1]->name, name) == 0)
+			return (slot - 1);
+		h = (h + 1) & (OPTIONS_TABLE_HASHSIZE - 1);
+	}
+	return (-1);
+}
+
 /* Populate an options tree from a table. */
 void
 options_table_populate_tree(
@@ -24,65 +24,85 @@
 #include "tmux.h"
 
 /*
- * Option handling; each option has a name, type and value and is stored in
- * a splay tree.
+ * Option handling; each option has a name, type and value. Every option is in
+ * one of the tables in options-table.c, which gives it a slot number, and the
+ * options set in a struct options are kept in an array indexed by slot. The
+ * array is not allocated until the first option is set, so options which
+ * only inherit from their parent (as most session and window options do) take
+ * no space.
  */
 
-SPLAY_GENERATE(options_tree, options_entry, entry, options_cmp);
+int	options_slot(const char *);
+struct options_entry *options_new(struct options *, const char *);
+void	options_free_entry(struct options_entry *);
 
+/* Find the slot for an option name, which must be known. */
 int
-options_cmp(struct options_entry *o1, struct options_entry *o2)
+options_slot(const char *name)
 {
-	return (strcmp(o1->name, o2->name));
+	int	slot;
+
+	if ((slot = options_table_slot(name)) == -1)
+		log_fatalx("unknown option: %s", name);
+	return (slot);
 }
 
 void
 options_init(struct options *oo, struct options *parent)
 {
-	SPLAY_INIT(&oo->tree);
+	oo->slots = NULL;
 	oo->parent = parent;
 }
 
 void
 options_free(struct options *oo)
 {
-	struct options_entry	*o;
+	u_int	i;
 
-	while (!SPLAY_EMPTY(&oo->tree)) {
-		o = SPLAY_ROOT(&oo->tree);
-		SPLAY_REMOVE(options_tree, &oo->tree, o);
-		xfree(o->name);
-		if (o->type == OPTIONS_STRING)
-			xfree(o->str);
-		else if (o->type == OPTIONS_DATA)
-			o->freefn(o->data);
-		xfree(o);
+	if (oo->slots == NULL)
+		return;
+	for (i = 0; i < options_table_nslots; i++) {
+		if (oo->slots[i] != NULL)
+			options_free_entry(oo->slots[i]);
 	}
+	xfree(oo->slots);
+	oo->slots = NULL;
+}
+
+/* Free an option and its value. */
+void
+options_free_entry(struct options_entry *o)
+{
+	xfree(o->name);
+	if (o->type == OPTIONS_STRING)
+		xfree(o->str);
+	else if (o->type == OPTIONS_DATA)
+		o->freefn(o->data);
+	xfree(o);
 }
 
 struct options_entry *
 options_find1(struct options *oo, const char *name)
 {
-	struct options_entry	p;
+	int	slot;
 
-	p.name = (char *) name;
-	return (SPLAY_FIND(options_tree, &oo->tree, &p));
+	slot = options_slot(name);
+	if (oo->slots == NULL)
+		return (NULL);
+	return (oo->slots[slot]);
 }
 
 struct options_entry *
 options_find(struct options *oo, const char *name)
 {
-	struct options_entry	*o, p;
-
-	p.name = (char *) name;
-	o = SPLAY_FIND(options_tree, &oo->tree, &p);
-	while (o == NULL) {
-		oo = oo->parent;
-		if (oo == NULL)
-			break;
-		o = SPLAY_FIND(options_tree, &oo->tree, &p);
+	int	slot;
+
+	slot = options_slot(name);
+	for (; oo != NULL; oo = oo->parent) {
+		if (oo->slots != NULL && oo->slots[slot] != NULL)
+			return (oo->slots[slot]);
 	}
-	return (o);
+	return (NULL);
 }
 
 void
@@ -93,29 +113,39 @@ options_remove(struct options *oo, const char *name)
 	if ((o = options_find1(oo, name)) == NULL)
 		return;
 
-	SPLAY_REMOVE(options_tree, &oo->tree, o);
-	xfree(o->name);
-	if (o->type == OPTIONS_STRING)
-		xfree(o->str);
-	else if (o->type == OPTIONS_DATA)
-		o->freefn(o->data);
-	xfree(o);
+	oo->slots[options_slot(name)] = NULL;
+	options_free_entry(o);
 }
 
-struct options_entry *printflike3
-options_set_string(struct options *oo, const char *name, const char *fmt, ...)
+/* Get an option to set, creating it or freeing its old value. */
+struct options_entry *
+options_new(struct options *oo, const char *name)
 {
 	struct options_entry	*o;
-	va_list			 ap;
+	int			 slot;
+
+	slot = options_slot(name);
+	if (oo->slots == NULL)
+		oo->slots = xcalloc(options_table_nslots, sizeof *oo->slots);
 
-	if ((o = options_find1(oo, name)) == NULL) {
+	if ((o = oo->slots[slot]) == NULL) {
 		o = xmalloc(sizeof *o);
 		o->name = xstrdup(name);
-		SPLAY_INSERT(options_tree, &oo->tree, o);
+		oo->slots[slot] = o;
 	} else if (o->type == OPTIONS_STRING)
 		xfree(o->str);
 	else if (o->type == OPTIONS_DATA)
 		o->freefn(o->data);
+	return (o);
+}
+
+struct options_entry *printflike3
+options_set_string(struct options *oo, const char *name, const char *fmt, ...)
+{
+	struct options_entry	*o;
+	va_list			 ap;
+
+	o = options_new(oo, name);
 
 	va_start(ap, fmt);
 	o->type = OPTIONS_STRING;
@@ -141,14 +171,7 @@ options_set_number(struct options *oo, const char *name, long long value)
 {
 	struct options_entry	*o;
 
-	if ((o = options_find1(oo, name)) == NULL) {
-		o = xmalloc(sizeof *o);
-		o->name = xstrdup(name);
-		SPLAY_INSERT(options_tree, &oo->tree, o);
-	} else if (o->type == OPTIONS_STRING)
-		xfree(o->str);
-	else if (o->type == OPTIONS_DATA)
-		o->freefn(o->data);
+	o = options_new(oo, name);
 
 	o->type = OPTIONS_NUMBER;
 	o->num = value;
@@ -173,14 +196,7 @@ options_set_data(
 {
 	struct options_entry	*o;
 
-	if ((o = options_find1(oo, name)) == NULL) {
-		o = xmalloc(sizeof *o);
-		o->name = xstrdup(name);
-		SPLAY_INSERT(options_tree, &oo->tree, o);
-	} else if (o->type == OPTIONS_STRING)
-		xfree(o->str);
-	else if (o->type == OPTIONS_DATA)
-		o->freefn(o->data);
+	o = options_new(oo, name);
 
 	o->type = OPTIONS_DATA;
 	o->data = value;
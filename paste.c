@@ -26,8 +26,52 @@
 /*
  * Stack of paste buffers. Note that paste buffer data is not necessarily a C
  * string!
+ *
+ * Buffers are never changed once created. Each has a reference count: the
+ * stack holds one, and anything which needs a buffer after a command has
+ * returned (such as save-buffer) takes another rather than copying the data.
+ * Replacing a buffer on the stack puts a new buffer in its place.
+ *
+ * The stack is a ring of buffer pointers, the top at index first, so pushing,
+ * popping and finding a buffer by index do not move the others.
  */
 
+void	paste_expand(struct paste_stack *);
+
+#define PASTE_ITEM(ps, idx) ((ps)->list[((ps)->first + (idx)) % (ps)->space])
+
+/* Initialise an empty stack. */
+void
+paste_init_stack(struct paste_stack *ps)
+{
+	ps->list = NULL;
+	ps->space = 0;
+	ps->first = 0;
+	ps->num = 0;
+}
+
+/* Make room for another buffer, moving the ring to the start of the list. */
+void
+paste_expand(struct paste_stack *ps)
+{
+	struct paste_buffer	**list;
+	u_int			  i, space;
+
+	if (ps->num < ps->space)
+		return;
+
+	space = ps->space == 0 ? 16 : ps->space * 2;
+	list = xcalloc(space, sizeof *list);
+	for (i = 0; i < ps->num; i++)
+		list[i] = PASTE_ITEM(ps, i);
+	if (ps->list != NULL)
+		xfree(ps->list);
+
+	ps->list = list;
+	ps->space = space;
+	ps->first = 0;
+}
+
 /* Return each item of the stack in turn. */
 struct paste_buffer *
 paste_walk_stack(struct paste_stack *ps, u_int *idx)
@@ -43,52 +87,114 @@ paste_walk_stack(struct paste_stack *ps, u_int *idx)
 struct paste_buffer *
 paste_get_top(struct paste_stack *ps)
 {
-	if (ARRAY_LENGTH(ps) == 0)
-		return (NULL);
-	return (ARRAY_FIRST(ps));
+	return (paste_get_index(ps, 0));
 }
 
 /* Get an item by its index. */
 struct paste_buffer *
 paste_get_index(struct paste_stack *ps, u_int idx)
 {
-	if (idx >= ARRAY_LENGTH(ps))
+	if (idx >= ps->num)
 		return (NULL);
-	return (ARRAY_ITEM(ps, idx));
+	return (PASTE_ITEM(ps, idx));
 }
 
-/* Free the top item on the stack. */
-int
-paste_free_top(struct paste_stack *ps)
+/* Create a buffer from data, which is taken over by the buffer. */
+struct paste_buffer *
+paste_create(char *data, size_t size)
 {
 	struct paste_buffer	*pb;
 
-	if (ARRAY_LENGTH(ps) == 0)
-		return (-1);
+	pb = xmalloc(sizeof *pb);
+	pb->data = data;
+	pb->size = size;
 
-	pb = ARRAY_FIRST(ps);
-	ARRAY_REMOVE(ps, 0);
+	pb->preview = NULL;
+	pb->preview_width = 0;
+
+	pb->references = 1;
+	return (pb);
+}
+
+/* Drop a reference to a buffer, freeing it if this was the last. */
+void
+paste_free(struct paste_buffer *pb)
+{
+	if (--pb->references != 0)
+		return;
 
 	xfree(pb->data);
+	if (pb->preview != NULL)
+		xfree(pb->preview);
 	xfree(pb);
+}
 
-	return (0);
+/* Free the top item on the stack. */
+int
+paste_free_top(struct paste_stack *ps)
+{
+	return (paste_free_index(ps, 0));
 }
 
-/* Free an item by index. */
+/*
+ * Free an item by index. The items on whichever side of it is shorter are
+ * moved up to close the gap.
+ */
 int
 paste_free_index(struct paste_stack *ps, u_int idx)
 {
 	struct paste_buffer	*pb;
+	u_int			 i;
 
-	if (idx >= ARRAY_LENGTH(ps))
+	if (idx >= ps->num)
 		return (-1);
+	pb = PASTE_ITEM(ps, idx);
+
+	if (idx < ps->num / 2) {
+		for (i = idx; i > 0; i--)
+			PASTE_ITEM(ps, i) = PASTE_ITEM(ps, i - 1);
+		ps->first = (ps->first + 1) % ps->space;
+	} else {
+		for (i = idx; i < ps->num - 1; i++)
+			PASTE_ITEM(ps, i) = PASTE_ITEM(ps, i + 1);
+	}
+	ps->num--;
 
-	pb = ARRAY_ITEM(ps, idx);
-	ARRAY_REMOVE(ps, idx);
+	paste_free(pb);
 
-	xfree(pb->data);
-	xfree(pb);
+	return (0);
+}
+
+/*
+ * Push a buffer onto the top of the stack, freeing the bottom if at limit. The
+ * stack takes over the caller's reference.
+ */
+void
+paste_push(struct paste_stack *ps, struct paste_buffer *pb, u_int limit)
+{
+	while (ps->num != 0 && ps->num >= limit) {
+		ps->num--;
+		paste_free(PASTE_ITEM(ps, ps->num));
+	}
+
+	paste_expand(ps);
+	ps->first = (ps->first + ps->space - 1) % ps->space;
+	ps->num++;
+	PASTE_ITEM(ps, 0) = pb;
+}
+
+/*
+ * Put a buffer in place of the item at an index. The stack takes over the
+ * caller's reference.
+ */
+int
+paste_set(struct paste_stack *ps, u_int idx, struct paste_buffer *pb)
+{
+	if (idx >= ps->num)
+		return (-1);
+
+	paste_free(PASTE_ITEM(ps, idx));
+	PASTE_ITEM(ps, idx) = pb;
 
 	return (0);
 }
@@ -100,23 +206,10 @@ paste_free_index(struct paste_stack *ps, u_int idx)
 void
 paste_add(struct paste_stack *ps, char *data, size_t size, u_int limit)
 {
-	struct paste_buffer	*pb;
-
 	if (size == 0)
 		return;
 
-	while (ARRAY_LENGTH(ps) >= limit) {
-		pb = ARRAY_LAST(ps);
-		xfree(pb->data);
-		xfree(pb);
-		ARRAY_TRUNC(ps, 1);
-	}
-
-	pb = xmalloc(sizeof *pb);
-	ARRAY_INSERT(ps, 0, pb);
-
-	pb->data = data;
-	pb->size = size;
+	paste_push(ps, paste_create(data, size), limit);
 }
 
 
@@ -127,25 +220,22 @@ paste_add(struct paste_stack *ps, char *data, size_t size, u_int limit)
 int
 paste_replace(struct paste_stack *ps, u_int idx, char *data, size_t size)
 {
-	struct paste_buffer	*pb;
-
 	if (size == 0)
 		return (0);
 
-	if (idx >= ARRAY_LENGTH(ps))
+	if (idx >= ps->num)
 		return (-1);
 
-	pb = ARRAY_ITEM(ps, idx);
-	xfree(pb->data);
-
-	pb->data = data;
-	pb->size = size;
+	paste_set(ps, idx, paste_create(data, size));
 
 	return (0);
 }
 
-/* Convert a buffer into a visible string. */
-char *
+/*
+ * Convert a buffer into a visible string. Buffers don't change, so this is
+ * worked out once for each width and kept.
+ */
+const char *
 paste_print(struct paste_buffer *pb, size_t width)
 {
 	char	*buf;
@@ -153,6 +243,9 @@ paste_print(struct paste_buffer *pb, size_t width)
 
 	if (width < 3)
 		width = 3;
+	if (pb->preview != NULL && pb->preview_width == width)
+		return (pb->preview);
+
 	buf = xmalloc(width * 4 + 1);
 
 	len = pb->size;
@@ -165,5 +258,10 @@ paste_print(struct paste_buffer *pb, size_t width)
 		strlcat(buf, "...", width);
 	}
 
+	if (pb->preview != NULL)
+		xfree(pb->preview);
+	pb->preview = buf;
+	pb->preview_width = width;
+
 	return (buf);
 }
@@ -48,15 +48,15 @@ recalculate_sizes(void)
 	struct session		*s;
 	struct client		*c;
 	struct window		*w;
+	struct winlink		*wl;
 	struct window_pane	*wp;
-	u_int		 	 i, j, ssx, ssy, has, limit;
+	u_int		 	 ssx, ssy, limit;
 	int		 	 flag;
 
 	RB_FOREACH(s, sessions, &sessions) {
 		ssx = ssy = UINT_MAX;
-		for (j = 0; j < ARRAY_LENGTH(&clients); j++) {
-			c = ARRAY_ITEM(&clients, j);
-			if (c == NULL || c->flags & CLIENT_SUSPENDED)
+		TAILQ_FOREACH(c, &clients, entry) {
+			if (c->flags & CLIENT_SUSPENDED)
 				continue;
 			if (c->session == s) {
 				if (c->tty.sx < ssx)
@@ -87,26 +87,23 @@ recalculate_sizes(void)
 		s->sy = ssy;
 	}
 
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		w = ARRAY_ITEM(&windows, i);
-		if (w == NULL)
-			continue;
+	/* The attached sessions may have changed, so update the lock timer. */
+	server_lock_schedule();
+
+	TAILQ_FOREACH(w, &windows, entry) {
 		flag = options_get_number(&w->options, "aggressive-resize");
 
 		ssx = ssy = UINT_MAX;
-		RB_FOREACH(s, sessions, &sessions) {
+		TAILQ_FOREACH(wl, &w->winlinks, wentry) {
+			s = wl->session;
 			if (s->flags & SESSION_UNATTACHED)
 				continue;
-			if (flag)
-				has = s->curw->window == w;
-			else
-				has = session_has(s, w) != NULL;
-			if (has) {
-				if (s->sx < ssx)
-					ssx = s->sx;
-				if (s->sy < ssy)
-					ssy = s->sy;
-			}
+			if (flag && s->curw != wl)
+				continue;
+			if (s->sx < ssx)
+				ssx = s->sx;
+			if (s->sy < ssy)
+				ssy = s->sy;
 		}
 		if (ssx == UINT_MAX || ssy == UINT_MAX)
 			continue;
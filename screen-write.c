@@ -558,6 +558,7 @@ screen_write_alignmenttest(struct screen_write_ctx *ctx)
 		for (xx = 0; xx < screen_size_x(s); xx++)
 			grid_view_set_cell(s->grid, xx, yy, &gc);
 	}
+	screen_written(s, 0, screen_size_y(s));
 
 	s->cx = 0;
 	s->cy = 0;
@@ -588,6 +589,7 @@ screen_write_insertcharacter(struct screen_write_ctx *ctx, u_int nx)
 
 	if (s->cx <= screen_size_x(s) - 1)
 		grid_view_insert_cells(s->grid, s->cx, s->cy, nx);
+	screen_written(s, s->cy, 1);
 
 	ttyctx.num = nx;
 	tty_write(tty_cmd_insertcharacter, &ttyctx);
@@ -612,6 +614,7 @@ screen_write_deletecharacter(struct screen_write_ctx *ctx, u_int nx)
 
 	if (s->cx <= screen_size_x(s) - 1)
 		grid_view_delete_cells(s->grid, s->cx, s->cy, nx);
+	screen_written(s, s->cy, 1);
 
 	ttyctx.num = nx;
 	tty_write(tty_cmd_deletecharacter, &ttyctx);
@@ -636,6 +639,7 @@ screen_write_insertline(struct screen_write_ctx *ctx, u_int ny)
 		screen_write_initctx(ctx, &ttyctx, 0);
 
 		grid_view_insert_lines(s->grid, s->cy, ny);
+		screen_written(s, s->cy, screen_size_y(s) - s->cy);
 
 		ttyctx.num = ny;
 		tty_write(tty_cmd_insertline, &ttyctx);
@@ -653,6 +657,7 @@ screen_write_insertline(struct screen_write_ctx *ctx, u_int ny)
 		grid_view_insert_lines(s->grid, s->cy, ny);
 	else
 		grid_view_insert_lines_region(s->grid, s->rlower, s->cy, ny);
+	screen_written(s, s->cy, s->rlower + 1 - s->cy);
 
 	ttyctx.num = ny;
 	tty_write(tty_cmd_insertline, &ttyctx);
@@ -677,6 +682,7 @@ screen_write_deleteline(struct screen_write_ctx *ctx, u_int ny)
 		screen_write_initctx(ctx, &ttyctx, 0);
 
 		grid_view_delete_lines(s->grid, s->cy, ny);
+		screen_written(s, s->cy, screen_size_y(s) - s->cy);
 
 		ttyctx.num = ny;
 		tty_write(tty_cmd_deleteline, &ttyctx);
@@ -694,6 +700,7 @@ screen_write_deleteline(struct screen_write_ctx *ctx, u_int ny)
 		grid_view_delete_lines(s->grid, s->cy, ny);
 	else
 		grid_view_delete_lines_region(s->grid, s->rlower, s->cy, ny);
+	screen_written(s, s->cy, s->rlower + 1 - s->cy);
 
 	ttyctx.num = ny;
 	tty_write(tty_cmd_deleteline, &ttyctx);
@@ -787,9 +794,10 @@ screen_write_reverseindex(struct screen_write_ctx *ctx)
 
 	screen_write_initctx(ctx, &ttyctx, 0);
 
-	if (s->cy == s->rupper)
+	if (s->cy == s->rupper) {
 		grid_view_scroll_region_down(s->grid, s->rupper, s->rlower);
-	else if (s->cy > 0)
+		screen_written(s, s->rupper, s->rlower + 1 - s->rupper);
+	} else if (s->cy > 0)
 		s->cy--;
 
 	tty_write(tty_cmd_reverseindex, &ttyctx);
@@ -841,6 +849,18 @@ screen_write_utf8mousemode(struct screen_write_ctx *ctx, int state)
 		s->mode &= ~MODE_MOUSE_UTF8;
 }
 
+/* Set bracketed paste mode. */
+void
+screen_write_bracketpaste(struct screen_write_ctx *ctx, int state)
+{
+	struct screen	*s = ctx->s;
+
+	if (state)
+		s->mode |= MODE_BRACKETPASTE;
+	else
+		s->mode &= ~MODE_BRACKETPASTE;
+}
+
 /* Set mouse mode off. */
 void
 screen_write_mousemode_off(struct screen_write_ctx *ctx)
@@ -876,9 +896,13 @@ screen_write_linefeed(struct screen_write_ctx *ctx, int wrapped)
 	else
 		gl->flags &= ~GRID_LINE_WRAPPED;
 
-	if (s->cy == s->rlower)
+	if (s->cy == s->rlower) {
 		grid_view_scroll_region_up(s->grid, s->rupper, s->rlower);
-	else if (s->cy < screen_size_y(s) - 1)
+		if (s->rupper == 0 && s->rlower == screen_size_y(s) - 1)
+			screen_written_scroll(s);
+		else
+			screen_written(s, s->rupper, s->rlower + 1 - s->rupper);
+	} else if (s->cy < screen_size_y(s) - 1)
 		s->cy++;
 
 	ttyctx.num = wrapped;
@@ -1066,6 +1090,7 @@ screen_write_cell(struct screen_write_ctx *ctx,
 
 	/* Set the cell. */
 	grid_view_set_cell(gd, s->cx, s->cy, gc);
+	screen_written(s, s->cy, 1);
 	if (gc->flags & GRID_FLAG_UTF8) {
 		/* Construct UTF-8 and write it. */
 		grid_utf8_set(&gu, utf8data);
@@ -1128,6 +1153,7 @@ screen_write_combine(
 
 	/* Append the current cell. */
 	gu = grid_view_get_utf8(gd, s->cx - 1, s->cy);
+	screen_written(s, s->cy, 1);
 	if (grid_utf8_append(gu, utf8data) != 0) {
 		/* Failed: scrap this character and replace with underscores. */
 		if (gu->width == 1) {
@@ -63,6 +63,7 @@ screen_reinit(struct screen *s)
 	screen_reset_tabs(s);
 
 	grid_clear_lines(s->grid, s->grid->hsize, s->grid->sy);
+	screen_written_reset(s);
 
 	screen_clear_selection(s);
 }
@@ -143,6 +144,47 @@ screen_resize(struct screen *s, u_int sx, u_int sy)
 
 	if (sy != screen_size_y(s))
 		screen_resize_y(s, sy);
+
+	screen_written(s, 0, screen_size_y(s));
+}
+
+/*
+ * Note that ny lines from py have been written, so that monitor-content only
+ * needs to look at these rather than the whole screen.
+ */
+void
+screen_written(struct screen *s, u_int py, u_int ny)
+{
+	if (ny == 0)
+		return;
+
+	if (py < s->wupper)
+		s->wupper = py;
+	if (py + ny - 1 > s->wlower)
+		s->wlower = py + ny - 1;
+}
+
+/* The whole screen has scrolled up by one line. */
+void
+screen_written_scroll(struct screen *s)
+{
+	if (s->wupper > s->wlower)
+		return;
+	if (s->wlower == 0) {
+		screen_written_reset(s);
+		return;
+	}
+	if (s->wupper != 0)
+		s->wupper--;
+	s->wlower--;
+}
+
+/* Forget written lines once they have been checked. */
+void
+screen_written_reset(struct screen *s)
+{
+	s->wupper = UINT_MAX;
+	s->wlower = 0;
 }
 
 void
@@ -217,6 +259,8 @@ screen_resize_y(struct screen *s, u_int sy)
 		}
 		s->cy -= needed;
 	}
+	if (gd->index != NULL)
+		grid_index_update(gd);
 
 	/* Resize line arrays. */
 	gd->linedata = xrealloc(
@@ -236,6 +280,8 @@ screen_resize_y(struct screen *s, u_int sy)
 				available = needed;
 			gd->hsize -= available;
 			s->cy += available;
+			if (gd->index != NULL)
+				grid_index_truncate(gd);
 		} else
 			available = 0;
 		needed -= available;
@@ -34,13 +34,18 @@ void	server_client_check_redraw(struct client *);
 void	server_client_set_title(struct client *);
 void	server_client_reset_state(struct client *);
 void	server_client_in_callback(struct bufferevent *, short, void *);
+void	server_client_in_read_callback(struct bufferevent *, void *);
 void	server_client_out_callback(struct bufferevent *, short, void *);
+void	server_client_out_write_callback(struct bufferevent *, void *);
 void	server_client_err_callback(struct bufferevent *, short, void *);
 
 int	server_client_msg_dispatch(struct client *);
-void	server_client_msg_command(struct client *, struct msg_command_data *);
+void	server_client_msg_command(
+	    struct client *, struct msg_command_data *, const char *, size_t);
+void	server_client_msg_commanddata(struct client *, const char *, size_t);
 void	server_client_msg_identify(
 	    struct client *, struct msg_identify_data *, int);
+void	server_client_msg_environ(struct client *, char *, size_t);
 void	server_client_msg_shell(struct client *);
 
 void printflike2 server_client_msg_error(struct cmd_ctx *, const char *, ...);
@@ -52,7 +57,6 @@ void
 server_client_create(int fd)
 {
 	struct client	*c;
-	u_int		 i;
 
 	setblocking(fd, 0);
 
@@ -72,14 +76,14 @@ server_client_create(int fd)
 	c->tty.fd = -1;
 	c->title = NULL;
 
+	environ_init(&c->environ, NULL);
+
 	c->session = NULL;
 	c->last_session = NULL;
 	c->tty.sx = 80;
 	c->tty.sy = 24;
 
 	screen_init(&c->status, c->tty.sx, 1, 0);
-	RB_INIT(&c->status_new);
-	RB_INIT(&c->status_old);
 
 	c->message_string = NULL;
 	ARRAY_INIT(&c->message_log);
@@ -92,14 +96,9 @@ server_client_create(int fd)
 	c->last_mouse.x = c->last_mouse.y = -1;
 
 	evtimer_set(&c->repeat_timer, server_client_repeat_timer, c);
+	timer_set(&c->status_event, server_client_status_callback, c);
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		if (ARRAY_ITEM(&clients, i) == NULL) {
-			ARRAY_SET(&clients, i, c);
-			return;
-		}
-	}
-	ARRAY_ADD(&clients, c);
+	TAILQ_INSERT_TAIL(&clients, c, entry);
 	log_debug("new client %d", fd);
 }
 
@@ -110,11 +109,9 @@ server_client_lost(struct client *c)
 	struct message_entry	*msg;
 	u_int			 i;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		if (ARRAY_ITEM(&clients, i) == c)
-			ARRAY_SET(&clients, i, NULL);
-	}
+	TAILQ_REMOVE(&clients, c, entry);
 	log_debug("lost client %d", c->ibuf.fd);
+	c->flags |= CLIENT_DEAD;
 
 	/*
 	 * If CLIENT_TERMINAL hasn't been set, then tty_init hasn't been called
@@ -123,12 +120,16 @@ server_client_lost(struct client *c)
 	if (c->flags & CLIENT_TERMINAL)
 		tty_free(&c->tty);
 
+	if (c->stdin_callback != NULL)
+		c->stdin_callback(c, 1, c->stdin_data);
 	if (c->stdin_fd != -1) {
 		setblocking(c->stdin_fd, 1);
 		close(c->stdin_fd);
 	}
 	if (c->stdin_event != NULL)
 		bufferevent_free(c->stdin_event);
+	if (c->stdout_callback != NULL)
+		c->stdout_callback(c, 1, c->stdout_data);
 	if (c->stdout_fd != -1) {
 		setblocking(c->stdout_fd, 1);
 		close(c->stdout_fd);
@@ -142,12 +143,15 @@ server_client_lost(struct client *c)
 	if (c->stderr_event != NULL)
 		bufferevent_free(c->stderr_event);
 
-	status_free_jobs(&c->status_new);
-	status_free_jobs(&c->status_old);
+	if (c->command_data != NULL)
+		xfree(c->command_data);
+
+	timer_del(&c->status_event);
 	screen_free(&c->status);
 
 	if (c->title != NULL)
 		xfree(c->title);
+	environ_free(&c->environ);
 
 	evtimer_del(&c->repeat_timer);
 
@@ -174,15 +178,7 @@ server_client_lost(struct client *c)
 	imsg_clear(&c->ibuf);
 	event_del(&c->event);
 
-	for (i = 0; i < ARRAY_LENGTH(&dead_clients); i++) {
-		if (ARRAY_ITEM(&dead_clients, i) == NULL) {
-			ARRAY_SET(&dead_clients, i, c);
-			break;
-		}
-	}
-	if (i == ARRAY_LENGTH(&dead_clients))
-		ARRAY_ADD(&dead_clients, c);
-	c->flags |= CLIENT_DEAD;
+	TAILQ_INSERT_TAIL(&dead_clients, c, entry);
 
 	recalculate_sizes();
 	server_check_unattached();
@@ -219,44 +215,30 @@ client_lost:
 	server_client_lost(c);
 }
 
-/* Handle client status timer. */
+/*
+ * Client status timer: the status line is redrawn (and any jobs in it run
+ * again) every status-interval. The timer is set each time the status line is
+ * drawn.
+ */
 void
-server_client_status_timer(void)
+server_client_status_callback(void *data)
 {
-	struct client	*c;
-	struct session	*s;
-	struct timeval	 tv;
-	u_int		 i;
-	int		 interval;
-	time_t		 difference;
-
-	if (gettimeofday(&tv, NULL) != 0)
-		fatal("gettimeofday failed");
-
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL)
-			continue;
-		if (c->message_string != NULL || c->prompt_string != NULL) {
-			/*
-			 * Don't need timed redraw for messages/prompts so bail
-			 * now. The status timer isn't reset when they are
-			 * redrawn anyway.
-			 */
-			continue;
-		}
-		s = c->session;
-
-		if (!options_get_number(&s->options, "status"))
-			continue;
-		interval = options_get_number(&s->options, "status-interval");
+	struct client	*c = data;
+	struct session	*s = c->session;
 
-		difference = tv.tv_sec - c->status_timer.tv_sec;
-		if (difference >= interval) {
-			status_update_jobs(c);
-			c->flags |= CLIENT_STATUS;
-		}
+	if (s == NULL || c->flags & CLIENT_DEAD)
+		return;
+	if (c->message_string != NULL || c->prompt_string != NULL) {
+		/*
+		 * Don't need timed redraw for messages/prompts. The timer is
+		 * set again when the status line is next drawn.
+		 */
+		return;
 	}
+	if (!options_get_number(&s->options, "status"))
+		return;
+
+	c->flags |= CLIENT_STATUS;
 }
 
 /* Handle data key input from client. */
@@ -423,35 +405,30 @@ void
 server_client_loop(void)
 {
 	struct client		*c;
-	struct window		*w;
-	struct window_pane	*wp;
-	u_int		 	 i;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->flags & CLIENT_CONTROL)
+			control_check(c);
+		server_client_check_exit(c);
+		if (c->session == NULL)
 			continue;
 
-		server_client_check_exit(c);
-		if (c->session != NULL) {
-			server_client_check_redraw(c);
-			server_client_reset_state(c);
-		}
+		/*
+		 * Nothing can have been drawn unless the client has redraw
+		 * flags or its current window is dirty.
+		 */
+		if (!(c->flags & CLIENT_REDRAWFLAGS) &&
+		    !(c->session->curw->window->flags & WINDOW_DIRTY))
+			continue;
+		server_client_check_redraw(c);
+		server_client_reset_state(c);
 	}
 
 	/*
 	 * Any windows will have been redrawn as part of clients, so clear
 	 * their flags now.
 	 */
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		w = ARRAY_ITEM(&windows, i);
-		if (w == NULL)
-			continue;
-
-		w->flags &= ~WINDOW_REDRAW;
-		TAILQ_FOREACH(wp, &w->panes, entry)
-			wp->flags &= ~PANE_REDRAW;
-	}
+	server_window_clean();
 }
 
 /*
@@ -544,6 +521,14 @@ server_client_check_exit(struct client *c)
 	if (!(c->flags & CLIENT_EXIT))
 		return;
 
+	/*
+	 * Control clients stay until they close stdin and their last command
+	 * has finished.
+	 */
+	if (c->flags & CLIENT_CONTROL &&
+	    (c->stdin_fd != -1 || c->control_pending != 0))
+		return;
+
 	if (c->stdout_fd != -1 && c->stdout_event != NULL &&
 	    EVBUFFER_LENGTH(c->stdout_event->output) != 0)
 		return;
@@ -672,8 +657,8 @@ server_client_set_title(struct client *c)
 }
 
 /*
- * Error callback for client stdin. Caller must increase reference count when
- * enabling event!
+ * Error callback for client stdin. The stdin callback is told stdin has been
+ * closed; whoever set it must hold a reference to the client until then.
  */
 void
 server_client_in_callback(
@@ -681,7 +666,6 @@ server_client_in_callback(
 {
 	struct client	*c = data;
 
-	c->references--;
 	if (c->flags & CLIENT_DEAD)
 		return;
 
@@ -691,7 +675,17 @@ server_client_in_callback(
 	c->stdin_fd = -1;
 
 	if (c->stdin_callback != NULL)
-		c->stdin_callback(c, c->stdin_data);
+		c->stdin_callback(c, 1, c->stdin_data);
+}
+
+/* Read callback for client stdin, pass the data on as it arrives. */
+void
+server_client_in_read_callback(unused struct bufferevent *bufev, void *data)
+{
+	struct client	*c = data;
+
+	if (c->stdin_callback != NULL)
+		c->stdin_callback(c, 0, c->stdin_data);
 }
 
 /* Error callback for client stdout. */
@@ -705,6 +699,23 @@ server_client_out_callback(
 	setblocking(c->stdout_fd, 1);
 	close(c->stdout_fd);
 	c->stdout_fd = -1;
+
+	if (c->stdout_callback != NULL)
+		c->stdout_callback(c, 1, c->stdout_data);
+}
+
+/*
+ * Write callback for client stdout, called when the output has been written.
+ * Lets a command writing a large amount of data to stdout supply it a piece
+ * at a time.
+ */
+void
+server_client_out_write_callback(unused struct bufferevent *bufev, void *data)
+{
+	struct client	*c = data;
+
+	if (c->stdout_callback != NULL)
+		c->stdout_callback(c, 0, c->stdout_data);
 }
 
 /* Error callback for client stderr. */
@@ -727,7 +738,6 @@ server_client_msg_dispatch(struct client *c)
 	struct imsg		 imsg;
 	struct msg_command_data	 commanddata;
 	struct msg_identify_data identifydata;
-	struct msg_environ_data	 environdata;
 	ssize_t			 n, datalen;
 
 	if ((n = imsg_read(&c->ibuf)) == -1 || n == 0)
@@ -750,11 +760,16 @@ server_client_msg_dispatch(struct client *c)
 		log_debug("got %d from client %d", imsg.hdr.type, c->ibuf.fd);
 		switch (imsg.hdr.type) {
 		case MSG_COMMAND:
-			if (datalen != sizeof commanddata)
+			if (datalen < (ssize_t) sizeof commanddata)
 				fatalx("bad MSG_COMMAND size");
 			memcpy(&commanddata, imsg.data, sizeof commanddata);
 
-			server_client_msg_command(c, &commanddata);
+			server_client_msg_command(c, &commanddata,
+			    (char *) imsg.data + sizeof commanddata,
+			    datalen - sizeof commanddata);
+			break;
+		case MSG_COMMANDDATA:
+			server_client_msg_commanddata(c, imsg.data, datalen);
 			break;
 		case MSG_IDENTIFY:
 			if (datalen != sizeof identifydata)
@@ -765,7 +780,8 @@ server_client_msg_dispatch(struct client *c)
 
 			c->stdin_fd = imsg.fd;
 			c->stdin_event = bufferevent_new(c->stdin_fd,
-			    NULL, NULL, server_client_in_callback, c);
+			    server_client_in_read_callback, NULL,
+			    server_client_in_callback, c);
 			if (c->stdin_event == NULL)
 				fatalx("failed to create stdin event");
 			setblocking(c->stdin_fd, 0);
@@ -779,8 +795,9 @@ server_client_msg_dispatch(struct client *c)
 				fatalx("MSG_STDOUT missing fd");
 
 			c->stdout_fd = imsg.fd;
-			c->stdout_event = bufferevent_new(c->stdout_fd,
-			    NULL, NULL, server_client_out_callback, c);
+			c->stdout_event = bufferevent_new(c->stdout_fd, NULL,
+			    server_client_out_write_callback,
+			    server_client_out_callback, c);
 			if (c->stdout_event == NULL)
 				fatalx("failed to create stdout event");
 			setblocking(c->stdout_fd, 0);
@@ -836,13 +853,7 @@ server_client_msg_dispatch(struct client *c)
 			recalculate_sizes();
 			break;
 		case MSG_ENVIRON:
-			if (datalen != sizeof environdata)
-				fatalx("bad MSG_ENVIRON size");
-			memcpy(&environdata, imsg.data, sizeof environdata);
-
-			environdata.var[(sizeof environdata.var) - 1] = '\0';
-			if (strchr(environdata.var, '=') != NULL)
-				environ_put(&c->environ, environdata.var);
+			server_client_msg_environ(c, imsg.data, datalen);
 			break;
 		case MSG_SHELL:
 			if (datalen != 0)
@@ -901,13 +912,24 @@ server_client_msg_info(struct cmd_ctx *ctx, const char *fmt, ...)
 	bufferevent_write(ctx->cmdclient->stdout_event, "\n", 1);
 }
 
+/* Add to the packed argv of a command which is too long for one message. */
+void
+server_client_msg_commanddata(struct client *c, const char *buf, size_t len)
+{
+	c->command_data = xrealloc(c->command_data, 1, c->command_size + len);
+	memcpy(c->command_data + c->command_size, buf, len);
+	c->command_size += len;
+}
+
 /* Handle command message. */
 void
-server_client_msg_command(struct client *c, struct msg_command_data *data)
+server_client_msg_command(
+    struct client *c, struct msg_command_data *data, const char *buf,
+    size_t len)
 {
 	struct cmd_ctx	 ctx;
 	struct cmd_list	*cmdlist = NULL;
-	int		 argc;
+	int		 argc, retval;
 	char	       **argv, *cause;
 
 	ctx.error = server_client_msg_error;
@@ -919,10 +941,17 @@ server_client_msg_command(struct client *c, struct msg_command_data *data)
 
 	ctx.cmdclient = c;
 
+	/* Join the last piece of the arguments to any sent before it. */
+	server_client_msg_commanddata(c, buf, len);
+	server_client_msg_commanddata(c, "", 1);
+
 	argc = data->argc;
-	data->argv[(sizeof data->argv) - 1] = '\0';
-	if (cmd_unpack_argv(data->argv, sizeof data->argv, argc, &argv) != 0) {
-		server_client_msg_error(&ctx, "command too long");
+	retval = cmd_unpack_argv(c->command_data, c->command_size, argc, &argv);
+	xfree(c->command_data);
+	c->command_data = NULL;
+	c->command_size = 0;
+	if (retval != 0) {
+		server_client_msg_error(&ctx, "bad command arguments");
 		goto error;
 	}
 
@@ -962,6 +991,13 @@ server_client_msg_identify(
 	if (*data->cwd != '\0')
 		c->cwd = xstrdup(data->cwd);
 
+	if (data->flags & IDENTIFY_CONTROL) {
+		if (data->flags & IDENTIFY_CONTROLNOTIFY)
+			c->flags |= CLIENT_CONTROLNOTIFY;
+		control_start(c);
+		return;
+	}
+
 	if (!isatty(fd))
 	    return;
 	if ((tty_fd = dup(fd)) == -1)
@@ -982,6 +1018,22 @@ server_client_msg_identify(
 	c->flags |= CLIENT_TERMINAL;
 }
 
+/* Handle environment message, a list of variables each ending in a NUL. */
+void
+server_client_msg_environ(struct client *c, char *buf, size_t len)
+{
+	char	*end;
+
+	while (len != 0) {
+		if ((end = memchr(buf, '\0', len)) == NULL)
+			fatalx("bad MSG_ENVIRON data");
+		if (strchr(buf, '=') != NULL)
+			environ_put(&c->environ, buf);
+		len -= end + 1 - buf;
+		buf = end + 1;
+	}
+}
+
 /* Handle shell message. */
 void
 server_client_msg_shell(struct client *c)
@@ -27,6 +27,12 @@
 struct session *server_next_session(struct session *);
 void		server_callback_identify(int, short, void *);
 
+/*
+ * Set up the environment for a new process: TERM and TMUX on top of the
+ * session environment, or the global environment if there is no session.
+ * The parent's variable list is built here, before fork(), so it is kept for
+ * the next process.
+ */
 void
 server_fill_environ(struct session *s, struct environ *env)
 {
@@ -35,15 +41,22 @@ server_fill_environ(struct session *s, struct environ *env)
 	long	pid;
 
 	if (s != NULL) {
+		environ_init(env, &s->environ);
+
 		term = options_get_string(&s->options, "default-terminal");
 		environ_set(env, "TERM", term);
 
 		idx = s->idx;
-	} else
+	} else {
+		environ_init(env, &global_environ);
+
 		idx = -1;
+	}
 	pid = getpid();
 	xsnprintf(var, sizeof var, "%s,%ld,%d", socket_path, pid, idx);
 	environ_set(env, "TMUX", var);
+
+	environ_envp(env->parent);
 }
 
 void
@@ -64,11 +77,9 @@ server_write_session(
     struct session *s, enum msgtype type, const void *buf, size_t len)
 {
 	struct client	*c;
-	u_int		 i;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
 			continue;
 		if (c->session == s)
 			server_write_client(c, type, buf, len);
@@ -91,11 +102,9 @@ void
 server_redraw_session(struct session *s)
 {
 	struct client	*c;
-	u_int		 i;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
 			continue;
 		if (c->session == s)
 			server_redraw_client(c);
@@ -119,11 +128,9 @@ void
 server_status_session(struct session *s)
 {
 	struct client	*c;
-	u_int		 i;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
 			continue;
 		if (c->session == s)
 			server_status_client(c);
@@ -147,27 +154,24 @@ void
 server_redraw_window(struct window *w)
 {
 	struct client	*c;
-	u_int		 i;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
 			continue;
 		if (c->session->curw->window == w)
 			server_redraw_client(c);
 	}
 	w->flags |= WINDOW_REDRAW;
+	server_window_dirty(w);
 }
 
 void
 server_redraw_window_borders(struct window *w)
 {
 	struct client	*c;
-	u_int		 i;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
 			continue;
 		if (c->session->curw->window == w)
 			c->flags |= CLIENT_BORDERS;
@@ -177,7 +181,7 @@ server_redraw_window_borders(struct window *w)
 void
 server_status_window(struct window *w)
 {
-	struct session	*s;
+	struct winlink	*wl;
 
 	/*
 	 * This is slightly different. We want to redraw the status line of any
@@ -185,21 +189,17 @@ server_status_window(struct window *w)
 	 * current window.
 	 */
 
-	RB_FOREACH(s, sessions, &sessions) {
-		if (session_has(s, w) != NULL)
-			server_status_session(s);
-	}
+	TAILQ_FOREACH(wl, &w->winlinks, wentry)
+		server_status_session(wl->session);
 }
 
 void
 server_lock(void)
 {
 	struct client	*c;
-	u_int		 i;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
 			continue;
 		server_lock_client(c);
 	}
@@ -209,11 +209,9 @@ void
 server_lock_session(struct session *s)
 {
 	struct client	*c;
-	u_int		 i;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL || c->session != s)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL || c->session != s)
 			continue;
 		server_lock_client(c);
 	}
@@ -245,24 +243,20 @@ server_lock_client(struct client *c)
 void
 server_kill_window(struct window *w)
 {
-	struct session	*s, *next_s;
+	struct session	*s;
 	struct winlink	*wl;
 
-	next_s = RB_MIN(sessions, &sessions);
-	while (next_s != NULL) {
-		s = next_s;
-		next_s = RB_NEXT(sessions, &sessions, s);
-
-		if (session_has(s, w) == NULL)
-			continue;
-		while ((wl = winlink_find_by_window(&s->windows, w)) != NULL) {
-			if (session_detach(s, wl)) {
-				server_destroy_session_group(s);
-				break;
-			} else
-				server_redraw_session_group(s);
-		}
+	/* Keep the window until the last winlink is gone. */
+	w->references++;
+	while ((wl = TAILQ_FIRST(&w->winlinks)) != NULL) {
+		s = wl->session;
+		if (session_detach(s, wl))
+			server_destroy_session_group(s);
+		else
+			server_redraw_session_group(s);
 	}
+	if (--w->references == 0)
+		window_destroy(w);
 }
 
 int
@@ -331,14 +325,17 @@ server_destroy_pane(struct window_pane *wp)
 {
 	struct window	*w = wp->window;
 
+	window_pane_paste_clear(wp);
 	if (wp->fd != -1) {
 		close(wp->fd);
 		bufferevent_free(wp->event);
 		wp->fd = -1;
 	}
 
-	if (options_get_number(&w->options, "remain-on-exit"))
+	if (options_get_number(&w->options, "remain-on-exit")) {
+		queue_window_name(w);
 		return;
+	}
 
 	layout_close_pane(wp);
 	window_remove_pane(w, wp);
@@ -385,16 +382,14 @@ server_destroy_session(struct session *s)
 {
 	struct client	*c;
 	struct session	*s_new;
-	u_int		 i;
 
 	if (!options_get_number(&s->options, "detach-on-destroy"))
 		s_new = server_next_session(s);
 	else
 		s_new = NULL;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session != s)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session != s)
 			continue;
 		if (s_new == NULL) {
 			c->session = NULL;
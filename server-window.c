@@ -26,8 +26,50 @@
 int	server_window_check_bell(struct session *, struct winlink *);
 int	server_window_check_activity(struct session *, struct winlink *);
 int	server_window_check_silence(struct session *, struct winlink *);
-int	server_window_check_content(
-	    struct session *, struct winlink *, struct window_pane *);
+int	server_window_check_content(struct session *, struct winlink *,
+	    struct window_pane *, struct window_match *);
+
+/*
+ * Windows which have had output, alerts or redraw flags set since the last
+ * loop. Only these are looked at each time round, rather than every window.
+ */
+struct dirty_windows dirty_windows = TAILQ_HEAD_INITIALIZER(dirty_windows);
+
+/* Add a window to the dirty list if it isn't already on it. */
+void
+server_window_dirty(struct window *w)
+{
+	if (w->flags & WINDOW_DIRTY)
+		return;
+	w->flags |= WINDOW_DIRTY;
+	TAILQ_INSERT_TAIL(&dirty_windows, w, dirty_entry);
+}
+
+/*
+ * Clear redraw flags on dirty windows once all clients have been redrawn and
+ * take them off the list, unless they have alerts still to be checked.
+ */
+void
+server_window_clean(void)
+{
+	struct window		*w, *w1;
+	struct window_pane	*wp;
+
+	w1 = TAILQ_FIRST(&dirty_windows);
+	while (w1 != NULL) {
+		w = w1;
+		w1 = TAILQ_NEXT(w, dirty_entry);
+
+		w->flags &= ~WINDOW_REDRAW;
+		TAILQ_FOREACH(wp, &w->panes, entry)
+			wp->flags &= ~PANE_REDRAW;
+		if (w->flags & (WINDOW_BELL|WINDOW_ACTIVITY))
+			continue;
+
+		TAILQ_REMOVE(&dirty_windows, w, dirty_entry);
+		w->flags &= ~WINDOW_DIRTY;
+	}
+}
 
 /* Window functions that need to happen every loop. */
 void
@@ -37,26 +79,43 @@ server_window_loop(void)
 	struct winlink		*wl;
 	struct window_pane	*wp;
 	struct session		*s;
-	u_int		 	 i;
+	struct window_match	 wm, *content;
+	char			*ptr;
 
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		w = ARRAY_ITEM(&windows, i);
-		if (w == NULL)
+	TAILQ_FOREACH(w, &dirty_windows, dirty_entry) {
+		if (!(w->flags & (WINDOW_BELL|WINDOW_ACTIVITY|WINDOW_SILENCE)))
 			continue;
 
-		RB_FOREACH(s, sessions, &sessions) {
-			wl = session_has(s, w);
-			if (wl == NULL)
+		content = NULL;
+		if (w->flags & WINDOW_ACTIVITY) {
+			ptr = options_get_string(&w->options, "monitor-content");
+			if (ptr != NULL && *ptr != '\0') {
+				window_match_init(&wm, ptr);
+				content = &wm;
+			}
+		}
+
+		TAILQ_FOREACH(wl, &w->winlinks, wentry) {
+			s = wl->session;
+			if (session_has(s, w) != wl)
 				continue;
 
 			if (server_window_check_bell(s, wl) ||
 			    server_window_check_activity(s, wl) ||
 			    server_window_check_silence(s, wl))
 				server_status_session(s);
+			if (content == NULL)
+				continue;
 			TAILQ_FOREACH(wp, &w->panes, entry)
-				server_window_check_content(s, wl, wp);
+				server_window_check_content(s, wl, wp, content);
 		}
 		w->flags &= ~(WINDOW_BELL|WINDOW_ACTIVITY);
+
+		/* Only lines written from now on need to be checked again. */
+		if (content != NULL)
+			window_match_free(content);
+		TAILQ_FOREACH(wp, &w->panes, entry)
+			screen_written_reset(&wp->base);
 	}
 }
 
@@ -66,7 +125,6 @@ server_window_check_bell(struct session *s, struct winlink *wl)
 {
 	struct client	*c;
 	struct window	*w = wl->window;
-	u_int		 i;
 	int		 action, visual;
 
 	if (!(w->flags & WINDOW_BELL) || wl->flags & WINLINK_BELL)
@@ -80,9 +138,8 @@ server_window_check_bell(struct session *s, struct winlink *wl)
 		if (s->flags & SESSION_UNATTACHED)
 			break;
 		visual = options_get_number(&s->options, "visual-bell");
-		for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-			c = ARRAY_ITEM(&clients, i);
-			if (c == NULL || c->session != s)
+		TAILQ_FOREACH(c, &clients, entry) {
+			if (c->session != s)
 				continue;
 			if (!visual) {
 				tty_putcode(&c->tty, TTYC_BEL);
@@ -92,17 +149,15 @@ server_window_check_bell(struct session *s, struct winlink *wl)
 				status_message_set(c, "Bell in current window");
 				continue;
 			}
-			status_message_set(c, "Bell in window %u",
-			    winlink_find_by_window(&s->windows, w)->idx);
+			status_message_set(c, "Bell in window %u", wl->idx);
 		}
 		break;
 	case BELL_CURRENT:
 		if (s->flags & SESSION_UNATTACHED)
 			break;
 		visual = options_get_number(&s->options, "visual-bell");
-		for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-			c = ARRAY_ITEM(&clients, i);
-			if (c == NULL || c->session != s)
+		TAILQ_FOREACH(c, &clients, entry) {
+			if (c->session != s)
 				continue;
 			if (c->session->curw->window != w)
 				continue;
@@ -124,7 +179,6 @@ server_window_check_activity(struct session *s, struct winlink *wl)
 {
 	struct client	*c;
 	struct window	*w = wl->window;
-	u_int		 i;
 
 	if (!(w->flags & WINDOW_ACTIVITY) || wl->flags & WINLINK_ACTIVITY)
 		return (0);
@@ -137,12 +191,10 @@ server_window_check_activity(struct session *s, struct winlink *wl)
 	wl->flags |= WINLINK_ACTIVITY;
 
 	if (options_get_number(&s->options, "visual-activity")) {
-		for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-			c = ARRAY_ITEM(&clients, i);
-			if (c == NULL || c->session != s)
+		TAILQ_FOREACH(c, &clients, entry) {
+			if (c->session != s)
 				continue;
-			status_message_set(c, "Activity in window %u",
-			    winlink_find_by_window(&s->windows, w)->idx);
+			status_message_set(c, "Activity in window %u", wl->idx);
 		}
 	}
 
@@ -156,7 +208,6 @@ server_window_check_silence(struct session *s, struct winlink *wl)
 	struct client	*c;
 	struct window	*w = wl->window;
 	struct timeval	 timer;
-	u_int		 i;
 	int		 silence_interval, timer_difference;
 
 	if (!(w->flags & WINDOW_SILENCE) || wl->flags & WINLINK_SILENCE)
@@ -170,6 +221,7 @@ server_window_check_silence(struct session *s, struct winlink *wl)
 		 */
 		if (gettimeofday(&w->silence_timer, NULL) != 0)
 			fatal("gettimeofday failed.");
+		server_window_silence_schedule(w);
 
 		return (0);
 	}
@@ -186,27 +238,28 @@ server_window_check_silence(struct session *s, struct winlink *wl)
 	wl->flags |= WINLINK_SILENCE;
 
 	if (options_get_number(&s->options, "visual-silence")) {
-		for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-			c = ARRAY_ITEM(&clients, i);
-			if (c == NULL || c->session != s)
+		TAILQ_FOREACH(c, &clients, entry) {
+			if (c->session != s)
 				continue;
-			status_message_set(c, "Silence in window %u",
-			    winlink_find_by_window(&s->windows, w)->idx);
+			status_message_set(c, "Silence in window %u", wl->idx);
 		}
 	}
 
 	return (1);
 }
 
-/* Check for content change in window. */
+/*
+ * Check for content change in window. Only the lines of the pane written since
+ * the last check are searched.
+ */
 int
-server_window_check_content(
-    struct session *s, struct winlink *wl, struct window_pane *wp)
+server_window_check_content(struct session *s, struct winlink *wl,
+    struct window_pane *wp, struct window_match *wm)
 {
 	struct client	*c;
 	struct window	*w = wl->window;
-	u_int		 i;
-	char		*found, *ptr;
+	struct screen	*sc = &wp->base;
+	char		*found;
 
 	/* Activity flag must be set for new content. */
 	if (!(w->flags & WINDOW_ACTIVITY) || wl->flags & WINLINK_CONTENT)
@@ -214,24 +267,49 @@ server_window_check_content(
 	if (s->curw == wl)
 		return (0);
 
-	ptr = options_get_string(&w->options, "monitor-content");
-	if (ptr == NULL || *ptr == '\0')
+	if (sc->wupper > sc->wlower)
 		return (0);
-	if ((found = window_pane_search(wp, ptr, NULL)) == NULL)
+	found = window_pane_search(
+	    wp, wm, sc->wupper, sc->wlower + 1 - sc->wupper, NULL);
+	if (found == NULL)
 		return (0);
 	xfree(found);
 
 	wl->flags |= WINLINK_CONTENT;
 
 	if (options_get_number(&s->options, "visual-content")) {
-		for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-			c = ARRAY_ITEM(&clients, i);
-			if (c == NULL || c->session != s)
+		TAILQ_FOREACH(c, &clients, entry) {
+			if (c->session != s)
 				continue;
-			status_message_set(c, "Content in window %u",
-			    winlink_find_by_window(&s->windows, w)->idx);
+			status_message_set(c, "Content in window %u", wl->idx);
 		}
 	}
 
 	return (1);
 }
+
+/*
+ * Set the silence timer for a window to when it will have been silent for
+ * monitor-silence seconds.
+ */
+void
+server_window_silence_schedule(struct window *w)
+{
+	int	interval;
+
+	interval = options_get_number(&w->options, "monitor-silence");
+	if (interval == 0) {
+		timer_del(&w->silence_event);
+		return;
+	}
+	timer_add(&w->silence_event, w->silence_timer.tv_sec + interval + 1);
+}
+
+/* Silence timer: put the window on the dirty list to be checked. */
+void
+server_window_silence_callback(void *data)
+{
+	struct window	*w = data;
+
+	server_window_dirty(w);
+}
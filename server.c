@@ -48,7 +48,7 @@ struct clients	 dead_clients;
 int		 server_fd;
 int		 server_shutdown;
 struct event	 server_ev_accept;
-struct event	 server_ev_second;
+struct timer	 server_lock_timer;
 
 struct paste_stack global_buffers;
 
@@ -62,7 +62,7 @@ void		 server_signal_callback(int, short, void *);
 void		 server_child_signal(void);
 void		 server_child_exited(pid_t, int);
 void		 server_child_stopped(pid_t, int);
-void		 server_second_callback(int, short, void *);
+void		 server_lock_callback(void *);
 void		 server_lock_server(void);
 void		 server_lock_sessions(void);
 
@@ -108,7 +108,6 @@ server_start(void)
 	struct window_pane	*wp;
 	int	 		 pair[2];
 	char			*cause;
-	struct timeval		 tv;
 	u_int			 i;
 
 	/* The first client is special and gets a socketpair; create it. */
@@ -141,17 +140,19 @@ server_start(void)
 	logfile("server");
 	log_debug("server started, pid %ld", (long) getpid());
 
-	ARRAY_INIT(&windows);
+	TAILQ_INIT(&windows);
 	RB_INIT(&all_window_panes);
-	ARRAY_INIT(&clients);
-	ARRAY_INIT(&dead_clients);
+	TAILQ_INIT(&clients);
+	TAILQ_INIT(&dead_clients);
 	RB_INIT(&sessions);
 	RB_INIT(&dead_sessions);
 	TAILQ_INIT(&session_groups);
-	ARRAY_INIT(&global_buffers);
+	paste_init_stack(&global_buffers);
 	mode_key_init_trees();
 	key_bindings_init();
 	utf8_build();
+	timer_init();
+	timer_set(&server_lock_timer, server_lock_callback, NULL);
 
 	start_time = time(NULL);
 	log_debug("socket path %s", socket_path);
@@ -192,11 +193,6 @@ server_start(void)
 	    server_fd, EV_READ|EV_PERSIST, server_accept_callback, NULL);
 	event_add(&server_ev_accept, NULL);
 
-	memset(&tv, 0, sizeof tv);
-	tv.tv_sec = 1;
-	evtimer_set(&server_ev_second, server_second_callback, NULL);
-	evtimer_add(&server_ev_second, &tv);
-
 	set_signals(server_signal_callback);
 	server_loop();
 	exit(0);
@@ -221,36 +217,31 @@ server_loop(void)
 int
 server_should_shutdown(void)
 {
-	u_int	i;
-
 	if (!options_get_number(&global_options, "exit-unattached")) {
 		if (!RB_EMPTY(&sessions))
 			return (0);
 	}
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		if (ARRAY_ITEM(&clients, i) != NULL)
-			return (0);
-	}
-	return (1);
+	return (TAILQ_EMPTY(&clients));
 }
 
 /* Shutdown the server by killing all clients and windows. */
 void
 server_send_shutdown(void)
 {
-	struct client	*c;
+	struct client	*c, *next_c;
 	struct session	*s, *next_s;
-	u_int		 i;
-
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c != NULL) {
-			if (c->flags & (CLIENT_BAD|CLIENT_SUSPENDED))
-				server_client_lost(c);
-			else
-				server_write_client(c, MSG_SHUTDOWN, NULL, 0);
-			c->session = NULL;
-		}
+
+	/* Losing a client takes it off the list, so find the next first. */
+	next_c = TAILQ_FIRST(&clients);
+	while (next_c != NULL) {
+		c = next_c;
+		next_c = TAILQ_NEXT(c, entry);
+
+		if (c->flags & (CLIENT_BAD|CLIENT_SUSPENDED))
+			server_client_lost(c);
+		else
+			server_write_client(c, MSG_SHUTDOWN, NULL, 0);
+		c->session = NULL;
 	}
 
 	s = RB_MIN(sessions, &sessions);
@@ -266,8 +257,7 @@ void
 server_clean_dead(void)
 {
 	struct session	*s, *next_s;
-	struct client	*c;
-	u_int		 i;
+	struct client	*c, *next_c;
 
 	s = RB_MIN(sessions, &dead_sessions);
 	while (s != NULL) {
@@ -280,12 +270,15 @@ server_clean_dead(void)
 		s = next_s;
 	}
 
-	for (i = 0; i < ARRAY_LENGTH(&dead_clients); i++) {
-		c = ARRAY_ITEM(&dead_clients, i);
-		if (c == NULL || c->references != 0)
-			continue;
-		ARRAY_SET(&dead_clients, i, NULL);
-		xfree(c);
+	next_c = TAILQ_FIRST(&dead_clients);
+	while (next_c != NULL) {
+		c = next_c;
+		next_c = TAILQ_NEXT(c, entry);
+
+		if (c->references == 0) {
+			TAILQ_REMOVE(&dead_clients, c, entry);
+			xfree(c);
+		}
 	}
 }
 
@@ -404,11 +397,8 @@ server_child_exited(pid_t pid, int status)
 	struct window		*w;
 	struct window_pane	*wp;
 	struct job		*job;
-	u_int		 	 i;
 
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		if ((w = ARRAY_ITEM(&windows, i)) == NULL)
-			continue;
+	TAILQ_FOREACH(w, &windows, entry) {
 		TAILQ_FOREACH(wp, &w->panes, entry) {
 			if (wp->pid == pid) {
 				server_destroy_pane(wp);
@@ -431,14 +421,11 @@ server_child_stopped(pid_t pid, int status)
 {
 	struct window		*w;
 	struct window_pane	*wp;
-	u_int			 i;
 
 	if (WSTOPSIG(status) == SIGTTIN || WSTOPSIG(status) == SIGTTOU)
 		return;
 
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		if ((w = ARRAY_ITEM(&windows, i)) == NULL)
-			continue;
+	TAILQ_FOREACH(w, &windows, entry) {
 		TAILQ_FOREACH(wp, &w->panes, entry) {
 			if (wp->pid == pid) {
 				if (killpg(pid, SIGCONT) != 0)
@@ -448,38 +435,54 @@ server_child_stopped(pid_t pid, int status)
 	}
 }
 
-/* Handle once-per-second timer events. */
+/* Lock timer: lock anything which has timed out and wait for the next. */
 /* ARGSUSED */
 void
-server_second_callback(unused int fd, unused short events, unused void *arg)
+server_lock_callback(unused void *data)
 {
-	struct window		*w;
-	struct window_pane	*wp;
-	struct timeval		 tv;
-	u_int		 	 i;
-
 	if (options_get_number(&global_s_options, "lock-server"))
 		server_lock_server();
 	else
 		server_lock_sessions();
+	server_lock_schedule();
+}
 
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		w = ARRAY_ITEM(&windows, i);
-		if (w == NULL)
-			continue;
+/*
+ * Set the lock timer for when the next attached session times out, or when
+ * the last one does if locking the whole server. Activity only ever moves this
+ * later, so it isn't updated for every key: the timer fires early and is set
+ * again instead.
+ */
+void
+server_lock_schedule(void)
+{
+	struct session	*s;
+	int		 timeout, all;
+	time_t		 when, next;
 
-		TAILQ_FOREACH(wp, &w->panes, entry) {
-			if (wp->mode != NULL && wp->mode->timer != NULL)
-				wp->mode->timer(wp);
+	all = options_get_number(&global_s_options, "lock-server");
+
+	next = 0;
+	RB_FOREACH(s, sessions, &sessions) {
+		if (s->flags & SESSION_UNATTACHED)
+			continue;
+		timeout = options_get_number(&s->options, "lock-after-time");
+		if (timeout <= 0) {
+			if (!all)
+				continue;
+			next = 0;	/* server can never lock */
+			break;
 		}
-	}
 
-	server_client_status_timer();
+		when = s->activity_time.tv_sec + timeout + 1;
+		if (next == 0 || (all && when > next) || (!all && when < next))
+			next = when;
+	}
 
-	evtimer_del(&server_ev_second);
-	memset(&tv, 0, sizeof tv);
-	tv.tv_sec = 1;
-	evtimer_add(&server_ev_second, &tv);
+	if (next == 0)
+		timer_del(&server_lock_timer);
+	else
+		timer_add(&server_lock_timer, next);
 }
 
 /* Lock the server if ALL sessions have hit the time limit. */
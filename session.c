@@ -105,7 +105,7 @@ session_create(const char *name, const char *cmd, const char *cwd,
 	RB_INIT(&s->windows);
 
 	options_init(&s->options, &global_s_options);
-	environ_init(&s->environ);
+	environ_init(&s->environ, &global_environ);
 	if (env != NULL)
 		environ_copy(env, &s->environ);
 
@@ -227,10 +227,8 @@ session_new(struct session *s,
 		xasprintf(cause, "index in use: %d", idx);
 		return (NULL);
 	}
+	wl->session = s;
 
-	environ_init(&env);
-	environ_copy(&global_environ, &env);
-	environ_copy(&s->environ, &env);
 	server_fill_environ(s, &env);
 
 	shell = options_get_string(&s->options, "default-shell");
@@ -265,6 +263,7 @@ session_attach(struct session *s, struct window *w, int idx, char **cause)
 		xasprintf(cause, "index in use: %d", idx);
 		return (NULL);
 	}
+	wl->session = s;
 	winlink_set_window(wl, w);
 
 	session_group_synchronize_from(s);
@@ -294,13 +293,7 @@ session_detach(struct session *s, struct winlink *wl)
 struct winlink *
 session_has(struct session *s, struct window *w)
 {
-	struct winlink	*wl;
-
-	RB_FOREACH(wl, winlinks, &s->windows) {
-		if (wl->window == w)
-			return (wl);
-	}
-	return (NULL);
+	return (winlink_find_by_window(&s->windows, w));
 }
 
 struct winlink *
@@ -333,10 +326,7 @@ session_next(struct session *s, int alert)
 	}
 	if (wl == s->curw)
 		return (1);
-	winlink_stack_remove(&s->lastw, wl);
-	winlink_stack_push(&s->lastw, s->curw);
-	s->curw = wl;
-	wl->flags &= ~WINLINK_ALERTFLAGS;
+	session_set_current(s, wl);
 	return (0);
 }
 
@@ -370,10 +360,7 @@ session_previous(struct session *s, int alert)
 	}
 	if (wl == s->curw)
 		return (1);
-	winlink_stack_remove(&s->lastw, wl);
-	winlink_stack_push(&s->lastw, s->curw);
-	s->curw = wl;
-	wl->flags &= ~WINLINK_ALERTFLAGS;
+	session_set_current(s, wl);
 	return (0);
 }
 
@@ -388,10 +375,7 @@ session_select(struct session *s, int idx)
 		return (-1);
 	if (wl == s->curw)
 		return (1);
-	winlink_stack_remove(&s->lastw, wl);
-	winlink_stack_push(&s->lastw, s->curw);
-	s->curw = wl;
-	wl->flags &= ~WINLINK_ALERTFLAGS;
+	session_set_current(s, wl);
 	return (0);
 }
 
@@ -406,12 +390,34 @@ session_last(struct session *s)
 		return (-1);
 	if (wl == s->curw)
 		return (1);
+	session_set_current(s, wl);
+	return (0);
+}
+
+/* Make a winlink the current window. */
+void
+session_set_current(struct session *s, struct winlink *wl)
+{
+	struct winlink	*old = s->curw;
+	struct window	*w;
 
 	winlink_stack_remove(&s->lastw, wl);
-	winlink_stack_push(&s->lastw, s->curw);
+	winlink_stack_push(&s->lastw, old);
 	s->curw = wl;
 	wl->flags &= ~WINLINK_ALERTFLAGS;
-	return (0);
+
+	/*
+	 * Silence in the window being left is counted from now, so its timer
+	 * doesn't trip as soon as it is switched away from.
+	 */
+	if (old == NULL)
+		return;
+	w = old->window;
+	if (w->flags & WINDOW_SILENCE) {
+		if (gettimeofday(&w->silence_timer, NULL) != 0)
+			fatal("gettimeofday failed");
+		server_window_silence_schedule(w);
+	}
 }
 
 /* Find the session group containing a session. */
@@ -546,6 +552,7 @@ session_group_synchronize1(struct session *target, struct session *s)
 	/* Link all the windows from the target. */
 	RB_FOREACH(wl, winlinks, ww) {
 		wl2 = winlink_add(&s->windows, wl->idx);
+		wl2->session = s;
 		winlink_set_window(wl2, wl->window);
 		wl2->flags |= wl->flags & WINLINK_ALERTFLAGS;
 	}
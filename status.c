@@ -34,6 +34,9 @@ char   *status_redraw_get_left(
 char   *status_redraw_get_right(
 	    struct client *, time_t, int, struct grid_cell *, size_t *);
 char   *status_find_job(struct client *, char **);
+void	status_start_job(struct status_out *, time_t);
+time_t	status_job_expiry(struct status_out *);
+void	status_expire_jobs(void *);
 void	status_job_free(void *);
 void	status_job_callback(struct job *);
 char   *status_print(
@@ -50,6 +53,11 @@ char   *status_prompt_complete(const char *);
 /* Status prompt history. */
 ARRAY_DECL(, char *) status_prompt_history = ARRAY_INITIALIZER;
 
+/* Shared status job output. */
+struct status_out_tree status_jobs;
+u_int	status_jobs_running;
+struct timer status_jobs_timer;
+
 /* Status output tree. */
 RB_GENERATE(status_out_tree, status_out, entry, status_out_cmp);
 
@@ -151,7 +159,7 @@ status_redraw(struct client *c)
 	u_int			offset, needed;
 	u_int			wlstart, wlwidth, wlavailable, wloffset, wlsize;
 	size_t			llen, rlen;
-	int			larrow, rarrow, utf8flag;
+	int			larrow, rarrow, utf8flag, interval;
 
 	/* No status line? */
 	if (c->tty.sy == 0 || !options_get_number(&s->options, "status"))
@@ -163,6 +171,11 @@ status_redraw(struct client *c)
 	if (gettimeofday(&c->status_timer, NULL) != 0)
 		fatal("gettimeofday failed");
 	t = c->status_timer.tv_sec;
+	interval = options_get_number(&s->options, "status-interval");
+	if (interval != 0)
+		timer_add(&c->status_event, t + interval);
+	else
+		timer_del(&c->status_event);
 
 	/* Set up default colour. */
 	memcpy(&stdgc, &grid_default_cell, sizeof gc);
@@ -517,8 +530,10 @@ status_find_job(struct client *c, char **iptr)
 {
 	struct status_out	*so, so_find;
 	char   			*cmd;
-	int			 lastesc;
+	int			 lastesc, interval;
 	size_t			 len;
+	time_t			 t;
+	u_int			 i;
 
 	if (**iptr == '\0')
 		return (NULL);
@@ -548,88 +563,145 @@ status_find_job(struct client *c, char **iptr)
 	(*iptr)++;			/* skip final ) */
 	cmd[len] = '\0';
 
-	/* First try in the new tree. */
+	/* Find the shared entry for this command or add a new one. */
 	so_find.cmd = cmd;
-	so = RB_FIND(status_out_tree, &c->status_new, &so_find);
-	if (so != NULL && so->out != NULL)
-		return (so->out);
-
-	/* If not found at all, start the job and add to the tree. */
+	so = RB_FIND(status_out_tree, &status_jobs, &so_find);
 	if (so == NULL) {
-		job_run(cmd, status_job_callback, status_job_free, c);
-		c->references++;
-
-		so = xmalloc(sizeof *so);
+		so = xcalloc(1, sizeof *so);
 		so->cmd = xstrdup(cmd);
-		so->out = NULL;
-		RB_INSERT(status_out_tree, &c->status_new, so);
+		RB_INSERT(status_out_tree, &status_jobs, so);
 	}
-
-	/* Lookup in the old tree. */
-	so_find.cmd = cmd;
-	so = RB_FIND(status_out_tree, &c->status_old, &so_find);
 	xfree(cmd);
-	if (so != NULL)
-		return (so->out);
-	return (NULL);
+
+	/* Remember which sessions use the entry so only they are redrawn. */
+	for (i = 0; i < ARRAY_LENGTH(&so->sessions); i++) {
+		if (ARRAY_ITEM(&so->sessions, i) == c->session->idx)
+			break;
+	}
+	if (i == ARRAY_LENGTH(&so->sessions))
+		ARRAY_ADD(&so->sessions, c->session->idx);
+
+	/*
+	 * Start the job if it isn't running and the last result is older than
+	 * the shortest interval asked for since it was started. Clients with
+	 * different intervals share the entry, so it is refreshed as often as
+	 * the shortest of them asks. An interval of zero means the job is run
+	 * once and not refreshed.
+	 */
+	t = time(NULL);
+	so->used = t;
+	interval = options_get_number(&c->session->options, "status-interval");
+	if (interval != 0 && (so->interval == 0 || interval < so->interval))
+		so->interval = interval;
+	if (!timer_pending(&status_jobs_timer)) {
+		timer_set(&status_jobs_timer, status_expire_jobs, NULL);
+		timer_add(&status_jobs_timer, status_job_expiry(so) + 1);
+	}
+	if (so->job == NULL && !so->waiting && (so->started == 0 ||
+	    (so->interval != 0 && t - so->started >= so->interval)))
+		status_start_job(so, t);
+
+	return (so->out);
 }
 
-/* Free job tree. */
+/* Start a status job, or mark it waiting if too many are already running. */
 void
-status_free_jobs(struct status_out_tree *sotree)
+status_start_job(struct status_out *so, time_t t)
+{
+	if (status_jobs_running >= STATUS_JOBS_MAX) {
+		so->waiting = 1;
+		return;
+	}
+	so->waiting = 0;
+
+	/* Clients set the interval again as they ask for the result. */
+	so->started = t;
+	so->interval = 0;
+	so->job = job_run(so->cmd, status_job_callback, status_job_free, so);
+	if (so->job != NULL)
+		status_jobs_running++;
+}
+
+/* Time after which an entry which has not been asked for is freed. */
+time_t
+status_job_expiry(struct status_out *so)
+{
+	int	interval;
+
+	/*
+	 * Twice the interval, but not too short since without an interval the
+	 * status line is only drawn when something changes.
+	 */
+	interval = so->interval;
+	if (interval < STATUS_JOBS_EXPIRE)
+		interval = STATUS_JOBS_EXPIRE;
+	return (so->used + interval * 2);
+}
+
+/*
+ * Expiry timer: free entries which have not been asked for recently and
+ * aren't running, and set the timer again for the next.
+ */
+/* ARGSUSED */
+void
+status_expire_jobs(unused void *data)
 {
 	struct status_out	*so, *so_next;
+	time_t			 t, when, next;
+
+	t = time(NULL);
 
-	so_next = RB_MIN(status_out_tree, sotree);
+	next = 0;
+	so_next = RB_MIN(status_out_tree, &status_jobs);
 	while (so_next != NULL) {
 		so = so_next;
-		so_next = RB_NEXT(status_out_tree, sotree, so);
+		so_next = RB_NEXT(status_out_tree, &status_jobs, so);
 
-		RB_REMOVE(status_out_tree, sotree, so);
+		when = status_job_expiry(so);
+		if (so->job != NULL || t <= when) {
+			if (next == 0 || when < next)
+				next = when;
+			continue;
+		}
+
+		RB_REMOVE(status_out_tree, &status_jobs, so);
 		if (so->out != NULL)
 			xfree(so->out);
+		ARRAY_FREE(&so->sessions);
 		xfree(so->cmd);
 		xfree(so);
 	}
-}
-
-/* Update jobs on status interval. */
-void
-status_update_jobs(struct client *c)
-{
-	/* Free the old tree. */
-	status_free_jobs(&c->status_old);
 
-	/* Move the new to old. */
-	memcpy(&c->status_old, &c->status_new, sizeof c->status_old);
-	RB_INIT(&c->status_new);
+	if (next != 0)
+		timer_add(&status_jobs_timer, next + 1);
 }
 
-/* Free status job. */
+/* Free status job: start the next waiting job if there is one. */
 void
 status_job_free(void *data)
 {
-	struct client	*c = data;
+	struct status_out	*so = data;
+
+	so->job = NULL;
+	status_jobs_running--;
 
-	c->references--;
+	RB_FOREACH(so, status_out_tree, &status_jobs) {
+		if (so->waiting) {
+			status_start_job(so, time(NULL));
+			break;
+		}
+	}
 }
 
-/* Job has finished: save its result. */
+/* Job has finished: save its result and redraw if it has changed. */
 void
 status_job_callback(struct job *job)
 {
-	struct client		*c = job->data;
-	struct status_out	*so, so_find;
+	struct status_out	*so = job->data;
+	struct client		*c;
 	char			*line, *buf;
 	size_t			 len;
-
-	if (c->flags & CLIENT_DEAD)
-		return;
-
-	so_find.cmd = job->cmd;
-	so = RB_FIND(status_out_tree, &c->status_new, &so_find);
-	if (so == NULL || so->out != NULL)
-		return;
+	u_int			 i;
 
 	buf = NULL;
 	if ((line = evbuffer_readline(job->event->input)) == NULL) {
@@ -641,8 +713,24 @@ status_job_callback(struct job *job)
 	} else
 		buf = xstrdup(line);
 
+	if (so->out != NULL && strcmp(so->out, buf) == 0) {
+		xfree(buf);
+		return;
+	}
+	if (so->out != NULL)
+		xfree(so->out);
 	so->out = buf;
-	server_status_client(c);
+
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
+			continue;
+		for (i = 0; i < ARRAY_LENGTH(&so->sessions); i++) {
+			if (ARRAY_ITEM(&so->sessions, i) == c->session->idx) {
+				server_status_client(c);
+				break;
+			}
+		}
+	}
 }
 
 /* Return winlink status line entry and adjust gc as necessary. */
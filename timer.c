@@ -0,0 +1,220 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+
+#include <string.h>
+#include <time.h>
+
+#include "tmux.h"
+
+/*
+ * Coarse server timers. Work which only needs one second resolution (the
+ * status interval, clock mode, lock-after-time and monitor-silence) is kept
+ * in a two level timer wheel. A single libevent timer is armed for the next
+ * second with anything due, so all timers due in the same second are run
+ * from one wakeup and nothing at all is run if no timers are waiting.
+ *
+ * The first level has a slot for each of the next TIMER_SLOTS seconds. The
+ * second level has a slot for each of the following TIMER_SLOTS blocks of
+ * TIMER_SLOTS seconds; a block is moved down to the first level when the
+ * wheel reaches it. Timers further away than that are put in the last block
+ * and moved again when it is reached.
+ */
+
+#define TIMER_BITS 6
+#define TIMER_SLOTS (1 << TIMER_BITS)
+#define TIMER_MASK (TIMER_SLOTS - 1)
+
+void	timer_insert(struct timer *);
+void	timer_cascade(void);
+void	timer_schedule(void);
+void	timer_callback(int, short, void *);
+
+struct timer_list timer_wheel[2][TIMER_SLOTS];
+time_t		  timer_now;
+u_int		  timer_count;
+
+struct event	  timer_event;
+time_t		  timer_next;
+
+/* Initialise the wheel. */
+void
+timer_init(void)
+{
+	u_int	i;
+
+	for (i = 0; i < TIMER_SLOTS; i++) {
+		TAILQ_INIT(&timer_wheel[0][i]);
+		TAILQ_INIT(&timer_wheel[1][i]);
+	}
+	timer_now = time(NULL);
+	timer_count = 0;
+
+	evtimer_set(&timer_event, timer_callback, NULL);
+	timer_next = 0;
+}
+
+/* Set up a timer. */
+void
+timer_set(struct timer *tm, void (*fn)(void *), void *data)
+{
+	tm->fn = fn;
+	tm->data = data;
+	tm->list = NULL;
+}
+
+/* Add or move a timer to fire at the given time. */
+void
+timer_add(struct timer *tm, time_t when)
+{
+	if (tm->list != NULL)
+		timer_del(tm);
+
+	/* Anything already due is run on the next second. */
+	if (when <= timer_now)
+		when = timer_now + 1;
+	tm->when = when;
+
+	timer_insert(tm);
+	timer_count++;
+
+	if (timer_next == 0 || when < timer_next)
+		timer_schedule();
+}
+
+/* Remove a timer if it is waiting. */
+void
+timer_del(struct timer *tm)
+{
+	if (tm->list == NULL)
+		return;
+	TAILQ_REMOVE(tm->list, tm, entry);
+	tm->list = NULL;
+	timer_count--;
+}
+
+/* Is this timer waiting? */
+int
+timer_pending(struct timer *tm)
+{
+	return (tm->list != NULL);
+}
+
+/* Put a timer in the right slot for its time. */
+void
+timer_insert(struct timer *tm)
+{
+	time_t	delta, block;
+
+	delta = tm->when - timer_now;
+	if (delta < TIMER_SLOTS)
+		tm->list = &timer_wheel[0][tm->when & TIMER_MASK];
+	else {
+		block = tm->when >> TIMER_BITS;
+		if (block - (timer_now >> TIMER_BITS) > TIMER_SLOTS)
+			block = (timer_now >> TIMER_BITS) + TIMER_SLOTS;
+		tm->list = &timer_wheel[1][block & TIMER_MASK];
+	}
+	TAILQ_INSERT_TAIL(tm->list, tm, entry);
+}
+
+/* Move the second level block for the current time down to the first. */
+void
+timer_cascade(void)
+{
+	struct timer_list	*list, moved;
+	struct timer		*tm;
+
+	list = &timer_wheel[1][(timer_now >> TIMER_BITS) & TIMER_MASK];
+	if (TAILQ_EMPTY(list))
+		return;
+
+	TAILQ_INIT(&moved);
+	while ((tm = TAILQ_FIRST(list)) != NULL) {
+		TAILQ_REMOVE(list, tm, entry);
+		TAILQ_INSERT_TAIL(&moved, tm, entry);
+	}
+	while ((tm = TAILQ_FIRST(&moved)) != NULL) {
+		TAILQ_REMOVE(&moved, tm, entry);
+		timer_insert(tm);
+	}
+}
+
+/* Arm the libevent timer for the next second with anything to do. */
+void
+timer_schedule(void)
+{
+	struct timeval	tv;
+	time_t		t, next;
+	u_int		i;
+
+	evtimer_del(&timer_event);
+	timer_next = 0;
+	if (timer_count == 0)
+		return;
+
+	/*
+	 * Wake up for the first non-empty slot or for the end of the current
+	 * block, whichever is first, so that the next block can be moved down.
+	 */
+	next = timer_now;
+	for (i = 1; i <= TIMER_SLOTS; i++) {
+		next = timer_now + i;
+		if ((next & TIMER_MASK) == 0)
+			break;
+		if (!TAILQ_EMPTY(&timer_wheel[0][next & TIMER_MASK]))
+			break;
+	}
+	timer_next = next;
+
+	t = time(NULL);
+	memset(&tv, 0, sizeof tv);
+	if (next > t)
+		tv.tv_sec = next - t;
+	evtimer_add(&timer_event, &tv);
+}
+
+/* Timer fired: run everything due up to now. */
+/* ARGSUSED */
+void
+timer_callback(unused int fd, unused short events, unused void *data)
+{
+	struct timer_list	*list;
+	struct timer		*tm;
+	time_t			 t;
+
+	t = time(NULL);
+	while (timer_now < t) {
+		timer_now++;
+		if ((timer_now & TIMER_MASK) == 0)
+			timer_cascade();
+
+		/*
+		 * Timers added by callbacks are always at least a second
+		 * away, so they can't end up on this list.
+		 */
+		list = &timer_wheel[0][timer_now & TIMER_MASK];
+		while ((tm = TAILQ_FIRST(list)) != NULL) {
+			timer_del(tm);
+			tm->fn(tm->data);
+		}
+	}
+
+	timer_schedule();
+}
@@ -62,7 +62,7 @@ __dead void
 usage(void)
 {
 	fprintf(stderr,
-	    "usage: %s [-28lquvV] [-c shell-command] [-f file] [-L socket-name]\n"
+	    "usage: %s [-28ClquvV] [-c shell-command] [-f file] [-L socket-name]\n"
 	    "            [-S socket-path] [command [flags]]\n",
 	    __progname);
 	exit(1);
@@ -228,7 +228,7 @@ main(int argc, char **argv)
 	quiet = flags = 0;
 	label = path = NULL;
 	login_shell = (**argv == '-');
-	while ((opt = getopt(argc, argv, "28c:df:lL:qS:uUvV")) != -1) {
+	while ((opt = getopt(argc, argv, "28c:Cdf:lL:qS:uUvV")) != -1) {
 		switch (opt) {
 		case '2':
 			flags |= IDENTIFY_256COLOURS;
@@ -238,6 +238,11 @@ main(int argc, char **argv)
 			flags |= IDENTIFY_88COLOURS;
 			flags &= ~IDENTIFY_256COLOURS;
 			break;
+		case 'C':
+			if (flags & IDENTIFY_CONTROL)
+				flags |= IDENTIFY_CONTROLNOTIFY;
+			flags |= IDENTIFY_CONTROL;
+			break;
 		case 'c':
 			if (shell_cmd != NULL)
 				xfree(shell_cmd);
@@ -282,6 +287,8 @@ main(int argc, char **argv)
 
 	if (shell_cmd != NULL && argc != 0)
 		usage();
+	if (flags & IDENTIFY_CONTROL && (shell_cmd != NULL || argc != 0))
+		usage();
 
 	log_open_tty(debug_level);
 
@@ -302,7 +309,7 @@ main(int argc, char **argv)
 			flags |= IDENTIFY_UTF8;
 	}
 
-	environ_init(&global_environ);
+	environ_init(&global_environ, NULL);
 	for (var = environ; *var != NULL; var++)
 		environ_put(&global_environ, *var);
 
@@ -19,7 +19,7 @@
 #ifndef TMUX_H
 #define TMUX_H
 
-#define PROTOCOL_VERSION 6
+#define PROTOCOL_VERSION 8
 
 #include <sys/param.h>
 #include <sys/time.h>
@@ -55,16 +55,21 @@ extern char   **environ;
 /* Automatic name refresh interval, in milliseconds. */
 #define NAME_INTERVAL 500
 
+/* Number of name timer sweeps a window is checked on after a change. */
+#define NAME_CHECKS 2
+
 /* Maximum data to buffer for output before suspending writing to a tty. */
 #define BACKOFF_THRESHOLD 16384
 
+/* Output buffered for a control client after which it is disconnected. */
+#define CONTROL_OUTPUT_MAX (8 * 1024 * 1024)
+
 /*
  * Maximum sizes of strings in message data. Don't forget to bump
  * PROTOCOL_VERSION if any of these change!
  */
-#define COMMAND_LENGTH 2048	/* packed argv size */
+#define COMMAND_LENGTH 2048	/* lock command size */
 #define TERMINAL_LENGTH 128	/* length of TERM environment variable */
-#define ENVIRON_LENGTH 1024	/* environment variable length */
 
 /*
  * UTF-8 data size. This must be big enough to hold combined characters as well
@@ -172,6 +177,12 @@ enum key_code {
 	KEYC_KP_PERIOD,
 };
 
+/*
+ * Number of slots in a table indexed directly by key: one for each set of
+ * ESCAPE, CTRL and SHIFT modifiers for each byte and each key above.
+ */
+#define KEYC_NSLOTS ((256 + KEYC_KP_PERIOD + 1 - KEYC_BASE) * 8)
+
 /* Termcap codes. */
 enum tty_code_code {
 	TTYC_AX = 0,
@@ -380,7 +391,8 @@ enum msgtype {
 	MSG_SHELL,
 	MSG_STDERR,
 	MSG_STDOUT,
-	MSG_DETACHKILL
+	MSG_DETACHKILL,
+	MSG_COMMANDDATA
 };
 
 /*
@@ -388,12 +400,18 @@ enum msgtype {
  *
  * Don't forget to bump PROTOCOL_VERSION if any of these change!
  */
+/*
+ * MSG_ENVIRON carries as many environment variables as fit, each followed by
+ * a NUL.
+ *
+ * MSG_COMMAND is followed by the packed argv. If it is too long for one
+ * message, the start is sent before it in one or more MSG_COMMANDDATA.
+ */
 struct msg_command_data {
 	pid_t		pid;	/* PID from $TMUX or -1 */
 	int		idx;	/* index from $TMUX or -1 */
 
 	int		argc;
-	char		argv[COMMAND_LENGTH];
 };
 
 struct msg_identify_data {
@@ -404,6 +422,8 @@ struct msg_identify_data {
 #define IDENTIFY_UTF8 0x1
 #define IDENTIFY_256COLOURS 0x2
 #define IDENTIFY_88COLOURS 0x4
+#define IDENTIFY_CONTROL 0x8
+#define IDENTIFY_CONTROLNOTIFY 0x10
 	int		flags;
 };
 
@@ -411,10 +431,6 @@ struct msg_lock_data {
 	char		cmd[COMMAND_LENGTH];
 };
 
-struct msg_environ_data {
-	char		var[ENVIRON_LENGTH];
-};
-
 struct msg_shell_data {
 	char		shell[MAXPATHLEN];
 };
@@ -516,9 +532,18 @@ struct mode_key_entry {
 	enum mode_key_cmd	cmd;
 };
 
+/*
+ * Commands for each key in a mode key tree, indexed by mode and then by key
+ * slot. Zero (MODEKEY_NONE) is not bound.
+ */
+struct mode_key_index {
+	u_char			cmd[2][KEYC_NSLOTS];
+};
+
 /* Data required while mode keys are in use. */
 struct mode_key_data {
 	struct mode_key_tree   *tree;
+	struct mode_key_index  *index;
 	int			mode;
 };
 #define MODEKEY_EMACS 0
@@ -546,6 +571,7 @@ struct mode_key_table {
 	const char			*name;
 	const struct mode_key_cmdstr	*cmdstr;
 	struct mode_key_tree		*tree;
+	struct mode_key_index		*index;
 	const struct mode_key_entry	*table;	/* default entries */
 };
 
@@ -559,6 +585,7 @@ struct mode_key_table {
 #define MODE_MOUSE_BUTTON 0x40
 #define MODE_MOUSE_ANY 0x80
 #define MODE_MOUSE_UTF8 0x100
+#define MODE_BRACKETPASTE 0x200
 
 #define ALL_MOUSE_MODES (MODE_MOUSE_STANDARD|MODE_MOUSE_BUTTON|MODE_MOUSE_ANY)
 
@@ -643,8 +670,41 @@ struct grid {
 
 	u_int	hsize;
 	u_int	hlimit;
+	u_int	hcollected;	/* lines removed from the top of history */
 
 	struct grid_line *linedata;
+
+	struct grid_index *index;
+};
+
+/*
+ * Trigram index of the lines in grid history. Each list holds the absolute
+ * numbers (hcollected plus the line) of the lines containing a trigram
+ * hashing to it, in ascending order; lines collected from the top of the
+ * history are skipped by moving the start of each list.
+ */
+#define GRID_INDEX_BITS 12
+#define GRID_INDEX_SIZE (1 << GRID_INDEX_BITS)
+
+struct grid_index_list {
+	u_int	*list;
+	u_int	 first;
+	u_int	 num;
+	u_int	 space;
+};
+
+struct grid_index {
+	struct grid_index_list lists[GRID_INDEX_SIZE];
+	u_int	 next;		/* absolute number of next line to index */
+
+	char	*buf;
+	size_t	 bufsize;
+};
+
+/* Trigrams of a search string to look up in an index. */
+struct grid_index_query {
+	u_int	*keys;
+	u_int	 nkeys;
 };
 
 /* Option data structures. */
@@ -662,18 +722,27 @@ struct options_entry {
 	void		*data;
 
 	void		 (*freefn)(void *);
-
-	SPLAY_ENTRY(options_entry) entry;
 };
 
 struct options {
-	SPLAY_HEAD(options_tree, options_entry) tree;
-	struct options	*parent;
+	struct options_entry	**slots;
+	struct options		 *parent;
 };
 
 /* Key list for prefix option. */
 ARRAY_DECL(keylist, int);
 
+/* Coarse server timer. */
+struct timer {
+	void		(*fn)(void *);
+	void		*data;
+	time_t		 when;
+
+	struct timer_list *list;
+	TAILQ_ENTRY(timer) entry;
+};
+TAILQ_HEAD(timer_list, timer);
+
 /* Scheduled job. */
 struct job {
 	char		*cmd;
@@ -720,6 +789,9 @@ struct screen {
 	u_int		 rupper;	/* scroll region top */
 	u_int		 rlower;	/* scroll region bottom */
 
+	u_int		 wupper;	/* first line written since checked */
+	u_int		 wlower;	/* last line written since checked */
+
 	int		 mode;
 
 	bitstr_t	*tabs;
@@ -785,9 +857,35 @@ struct window_mode {
 	void	(*key)(struct window_pane *, struct session *, int);
 	void	(*mouse)(struct window_pane *,
 		    struct session *, struct mouse_event *);
-	void	(*timer)(struct window_pane *);
 };
 
+/*
+ * Search pattern for window names and pane contents, checked once when it is
+ * set up rather than for every line.
+ */
+struct window_match {
+	char		*pattern;	/* fnmatch(3) pattern or plain string */
+	int		 literal;
+};
+
+/* Paste queued for delivery to a pane. */
+struct window_pane_paste {
+	struct paste_buffer *pb;
+	size_t		 offset;
+
+	char		*sep;
+	size_t		 seplen;
+
+	struct evbuffer	*after;		/* input to write once finished */
+
+	int		 flags;
+#define PANE_PASTE_BRACKET 0x1
+#define PANE_PASTE_STARTED 0x2
+
+	TAILQ_ENTRY(window_pane_paste) entry;
+};
+TAILQ_HEAD(window_pane_pastes, window_pane_paste);
+
 /* Child window structure. */
 struct window_pane {
 	u_int		 id;
@@ -803,7 +901,6 @@ struct window_pane {
 
 	int		 flags;
 #define PANE_REDRAW 0x1
-#define PANE_FREEZE 0x2
 
 	char		*cmd;
 	char		*shell;
@@ -821,6 +918,8 @@ struct window_pane {
 	struct bufferevent *pipe_event;
 	size_t		 pipe_off;
 
+	struct window_pane_pastes pastes;
+
 	struct screen	*screen;
 	struct screen	 base;
 
@@ -842,8 +941,9 @@ RB_HEAD(window_pane_tree, window_pane);
 /* Window structure. */
 struct window {
 	char		*name;
-	struct event	 name_timer;
+	u_int		 name_checks;
 	struct timeval   silence_timer;
+	struct timer	 silence_event;
 
 	struct window_pane *active;
 	struct window_pane *last;
@@ -860,16 +960,24 @@ struct window {
 #define WINDOW_ACTIVITY 0x2
 #define WINDOW_REDRAW 0x4
 #define WINDOW_SILENCE 0x8
+#define WINDOW_DIRTY 0x10
 
 	struct options	 options;
 
 	u_int		 references;
+	TAILQ_HEAD(, winlink) winlinks;	/* every winlink to this window */
+
+	TAILQ_ENTRY(window) entry;
+	TAILQ_ENTRY(window) dirty_entry;
+	TAILQ_ENTRY(window) name_entry;
 };
-ARRAY_DECL(windows, struct window *);
+TAILQ_HEAD(windows, window);
+TAILQ_HEAD(dirty_windows, window);
 
 /* Entry on local window list. */
 struct winlink {
 	int		 idx;
+	struct session	*session;
 	struct window	*window;
 
 	size_t		 status_width;
@@ -886,6 +994,7 @@ struct winlink {
 
 	RB_ENTRY(winlink) entry;
 	TAILQ_ENTRY(winlink) sentry;
+	TAILQ_ENTRY(winlink) wentry;
 };
 RB_HEAD(winlinks, winlink);
 TAILQ_HEAD(winlink_stack, winlink);
@@ -918,12 +1027,30 @@ struct layout_cell {
 	TAILQ_ENTRY(layout_cell) entry;
 };
 
+/* Size of each piece when reading or writing paste buffers. */
+#define PASTE_CHUNK_SIZE 65536
+
 /* Paste buffer. */
 struct paste_buffer {
 	char		*data;
 	size_t		 size;
+
+	char		*preview;	/* cached paste_print result */
+	size_t		 preview_width;
+
+	u_int		 references;
+};
+
+/*
+ * Stack of paste buffers. This is a ring so buffers can be added or removed
+ * at either end without moving the others.
+ */
+struct paste_stack {
+	struct paste_buffer **list;
+	u_int		 space;
+	u_int		 first;
+	u_int		 num;
 };
-ARRAY_DECL(paste_stack, struct paste_buffer *);
 
 /* Environment variable. */
 struct environ_entry {
@@ -932,7 +1059,22 @@ struct environ_entry {
 
 	RB_ENTRY(environ_entry) entry;
 };
-RB_HEAD(environ, environ_entry);
+RB_HEAD(environ_tree, environ_entry);
+
+/*
+ * Set of environment variables. Variables not in the tree are looked for in
+ * the parent when spawning a process; a variable with no value hides one in
+ * the parent.
+ */
+struct environ {
+	struct environ_tree	 tree;
+	struct environ		*parent;
+
+	u_int			  generation;	/* bumped on each change */
+
+	char			**envp;		/* cached NAME=VALUE list */
+	u_int			  envp_generation;
+};
 
 /* Client session. */
 struct session_group {
@@ -978,14 +1120,21 @@ RB_HEAD(sessions, session);
 ARRAY_DECL(sessionslist, struct session *);
 
 /* TTY information. */
-struct tty_key {
-	char		 ch;
-	int		 key;
-
-	struct tty_key	*left;
-	struct tty_key	*right;
-
-	struct tty_key	*next;
+/*
+ * Key sequences for a terminal, as a table of states. next has a row of
+ * nclasses entries for each state, giving the state after each class of byte
+ * or 0 for no match.
+ */
+struct tty_key_table {
+	u_char		 classes[UCHAR_MAX + 1];
+	u_int		 nclasses;
+
+	u_int		 nstates;
+	u_short		*next;
+	int		*keys;
+	u_char		*flags;
+#define TTY_KEY_PARTIAL 0x1	/* longer keys start with this one */
+#define TTY_KEY_MOUSE 0x2	/* start of a mouse sequence */
 };
 
 struct tty_term {
@@ -996,6 +1145,8 @@ struct tty_term {
 
 	struct tty_code	 codes[NTTYCODE];
 
+	struct tty_key_table *keys;
+
 #define TERM_256COLOURS 0x1
 #define TERM_88COLOURS 0x2
 #define TERM_EARLYWRAP 0x4
@@ -1047,7 +1198,6 @@ struct tty {
 	void		 (*key_callback)(int, struct mouse_event *, void *);
 	void		*key_data;
 	struct event	 key_timer;
-	struct tty_key	*key_tree;
 };
 
 /* TTY command context and function pointer. */
@@ -1106,15 +1256,34 @@ struct message_entry {
 	time_t	msg_time;
 };
 
-/* Status output data from a job. */
+/*
+ * Status output data from a job. These are shared between all clients: each
+ * command is run at most once at a time and the last line of its output is
+ * kept until the next run finishes.
+ */
 struct status_out {
-	char   *cmd;
-	char   *out;
+	char		*cmd;
+	char		*out;
+
+	struct job	*job;		/* running job or NULL */
+	int		 waiting;	/* due but over STATUS_JOBS_MAX */
+
+	time_t		 started;	/* last time job started */
+	time_t		 used;		/* last time output requested */
+	int		 interval;	/* shortest interval asked since start */
+
+	ARRAY_DECL(, u_int) sessions;	/* indexes of sessions using it */
 
 	RB_ENTRY(status_out) entry;
 };
 RB_HEAD(status_out_tree, status_out);
 
+/* Maximum number of status jobs running at once. */
+#define STATUS_JOBS_MAX 16
+
+/* Minimum seconds before unused status job output is freed. */
+#define STATUS_JOBS_EXPIRE 30
+
 /* Client connection. */
 struct client {
 	struct imsgbuf	 ibuf;
@@ -1133,20 +1302,29 @@ struct client {
 
 	int		 stdin_fd;
 	void		*stdin_data;
-	void		(*stdin_callback)(struct client *, void *);
+	void		(*stdin_callback)(struct client *, int, void *);
 	struct bufferevent *stdin_event;
 
 	int		 stdout_fd;
+	void		*stdout_data;
+	void		(*stdout_callback)(struct client *, int, void *);
 	struct bufferevent *stdout_event;
 
 	int		 stderr_fd;
 	struct bufferevent *stderr_event;
 
+	u_int		 control_seq;	/* last control mode command */
+	u_int		 control_pending; /* command waiting to finish or 0 */
+	int		 control_references; /* references before it ran */
+	int		 control_error;	/* if the command reported an error */
+
+	char		*command_data;	/* packed argv from MSG_COMMANDDATA */
+	size_t		 command_size;
+
 	struct event	 repeat_timer;
 
-	struct status_out_tree status_old;
-	struct status_out_tree status_new;
 	struct timeval	 status_timer;
+	struct timer	 status_event;
 	struct screen	 status;
 
 #define CLIENT_TERMINAL 0x1
@@ -1163,6 +1341,10 @@ struct client {
 #define CLIENT_READONLY 0x800
 #define CLIENT_BACKOFF 0x1000
 #define CLIENT_REDRAWWINDOW 0x2000
+#define CLIENT_CONTROL 0x4000
+#define CLIENT_CONTROLNOTIFY 0x8000
+#define CLIENT_REDRAWFLAGS \
+    (CLIENT_REDRAW|CLIENT_STATUS|CLIENT_BORDERS|CLIENT_REDRAWWINDOW)
 	int		 flags;
 
 	struct event	 identify_timer;
@@ -1190,8 +1372,10 @@ struct client {
 	struct mouse_event last_mouse;
 
 	int		 references;
+
+	TAILQ_ENTRY(client) entry;	/* on clients or dead_clients */
 };
-ARRAY_DECL(clients, struct client *);
+TAILQ_HEAD(clients, client);
 
 /* Parsed arguments. */
 struct args {
@@ -1242,6 +1426,16 @@ struct cmd_list {
 	TAILQ_HEAD(, cmd) 	 list;
 };
 
+/* Cached command list parsed from a string. */
+struct cmd_string_entry {
+	char		*s;
+	struct cmd_list	*cmdlist;
+
+	RB_ENTRY(cmd_string_entry) entry;
+	TAILQ_ENTRY(cmd_string_entry) lru_entry;
+};
+RB_HEAD(cmd_string_tree, cmd_string_entry);
+
 struct cmd_entry {
 	const char	*name;
 	const char	*alias;
@@ -1358,12 +1552,13 @@ enum mode_key_cmd mode_key_fromstring(const struct mode_key_cmdstr *,
 	    const char *);
 const struct mode_key_table *mode_key_findtable(const char *);
 void	mode_key_init_trees(void);
+void	mode_key_add(const struct mode_key_table *, int, int,
+	    enum mode_key_cmd);
+void	mode_key_remove(const struct mode_key_table *, int, int);
 void	mode_key_init(struct mode_key_data *, struct mode_key_tree *);
 enum mode_key_cmd mode_key_lookup(struct mode_key_data *, int);
 
 /* options.c */
-int	options_cmp(struct options_entry *, struct options_entry *);
-SPLAY_PROTOTYPE(options_tree, options_entry, entry, options_cmp);
 void	options_init(struct options *, struct options *);
 void	options_free(struct options *);
 struct options_entry *options_find1(struct options *, const char *);
@@ -1383,11 +1578,20 @@ void   *options_get_data(struct options *, const char *);
 extern const struct options_table_entry server_options_table[];
 extern const struct options_table_entry session_options_table[];
 extern const struct options_table_entry window_options_table[];
+extern u_int options_table_nslots;
+int	options_table_slot(const char *);
 void	options_table_populate_tree(
 	    const struct options_table_entry *, struct options *);
 const char *options_table_print_entry(
 	    const struct options_table_entry *, struct options_entry *);
 
+/* timer.c */
+void	timer_init(void);
+void	timer_set(struct timer *, void (*)(void *), void *);
+void	timer_add(struct timer *, time_t);
+void	timer_del(struct timer *);
+int	timer_pending(struct timer *);
+
 /* job.c */
 extern struct joblist all_jobs;
 struct job *job_run(
@@ -1397,8 +1601,8 @@ void	job_died(struct job *, int);
 
 /* environ.c */
 int	environ_cmp(struct environ_entry *, struct environ_entry *);
-RB_PROTOTYPE(environ, environ_entry, entry, environ_cmp);
-void	environ_init(struct environ *);
+RB_PROTOTYPE(environ_tree, environ_entry, entry, environ_cmp);
+void	environ_init(struct environ *, struct environ *);
 void	environ_free(struct environ *);
 void	environ_copy(struct environ *, struct environ *);
 struct environ_entry *environ_find(struct environ *, const char *);
@@ -1406,6 +1610,7 @@ void	environ_set(struct environ *, const char *, const char *);
 void	environ_put(struct environ *, const char *);
 void	environ_unset(struct environ *, const char *);
 void	environ_update(const char *, struct environ *, struct environ *);
+char  **environ_envp(struct environ *);
 void	environ_push(struct environ *);
 
 /* tty.c */
@@ -1478,18 +1683,23 @@ const char	*tty_acs_get(struct tty *, u_char);
 
 /* tty-keys.c */
 void	tty_keys_init(struct tty *);
-void	tty_keys_free(struct tty *);
+void	tty_keys_free(struct tty_term *);
 int	tty_keys_next(struct tty *);
 
 /* paste.c */
+void		 paste_init_stack(struct paste_stack *);
 struct paste_buffer *paste_walk_stack(struct paste_stack *, u_int *);
 struct paste_buffer *paste_get_top(struct paste_stack *);
 struct paste_buffer *paste_get_index(struct paste_stack *, u_int);
+struct paste_buffer *paste_create(char *, size_t);
+void		 paste_free(struct paste_buffer *);
 int		 paste_free_top(struct paste_stack *);
 int		 paste_free_index(struct paste_stack *, u_int);
+void		 paste_push(struct paste_stack *, struct paste_buffer *, u_int);
+int		 paste_set(struct paste_stack *, u_int, struct paste_buffer *);
 void		 paste_add(struct paste_stack *, char *, size_t, u_int);
 int		 paste_replace(struct paste_stack *, u_int, char *, size_t);
-char		*paste_print(struct paste_buffer *, size_t);
+const char	*paste_print(struct paste_buffer *, size_t);
 
 /* clock.c */
 extern const char clock_table[14][5][5];
@@ -1511,6 +1721,7 @@ int		 cmd_pack_argv(int, char **, char *, size_t);
 int		 cmd_unpack_argv(char *, size_t, int, char ***);
 char	       **cmd_copy_argv(int, char *const *);
 void		 cmd_free_argv(int, char **);
+const struct cmd_entry *cmd_lookup(const char *, char **);
 struct cmd	*cmd_parse(int, char **, char **);
 int		 cmd_exec(struct cmd *, struct cmd_ctx *);
 void		 cmd_free(struct cmd *);
@@ -1584,6 +1795,7 @@ extern const struct cmd_entry cmd_respawn_window_entry;
 extern const struct cmd_entry cmd_rotate_window_entry;
 extern const struct cmd_entry cmd_run_shell_entry;
 extern const struct cmd_entry cmd_save_buffer_entry;
+extern const struct cmd_entry cmd_search_pane_entry;
 extern const struct cmd_entry cmd_select_layout_entry;
 extern const struct cmd_entry cmd_select_pane_entry;
 extern const struct cmd_entry cmd_select_window_entry;
@@ -1612,13 +1824,22 @@ extern const struct cmd_entry cmd_up_pane_entry;
 
 /* cmd-list.c */
 struct cmd_list	*cmd_list_parse(int, char **, char **);
+int		 cmd_list_flags(int, char **, int *, char **);
 int		 cmd_list_exec(struct cmd_list *, struct cmd_ctx *);
 void		 cmd_list_free(struct cmd_list *);
 size_t		 cmd_list_print(struct cmd_list *, char *, size_t);
 
 /* cmd-string.c */
+int	cmd_string_cmp(struct cmd_string_entry *, struct cmd_string_entry *);
+RB_PROTOTYPE(cmd_string_tree, cmd_string_entry, entry, cmd_string_cmp);
 int	cmd_string_parse(const char *, struct cmd_list **, char **);
 
+/* control.c */
+void	 control_start(struct client *);
+void	 control_check(struct client *);
+void	 control_notify_output(struct window_pane *, const u_char *, size_t);
+void	 control_notify_layout(struct window *);
+
 /* client.c */
 int	client_main(int, char **, int);
 
@@ -1626,6 +1847,7 @@ int	client_main(int, char **, int);
 extern struct key_bindings key_bindings;
 int	 key_bindings_cmp(struct key_binding *, struct key_binding *);
 SPLAY_PROTOTYPE(key_bindings, key_binding, entry, key_bindings_cmp);
+int	 key_bindings_slot(int);
 struct key_binding *key_bindings_lookup(int);
 void	 key_bindings_add(int, int, struct cmd_list *);
 void	 key_bindings_remove(int);
@@ -1646,16 +1868,22 @@ extern struct clients dead_clients;
 extern struct paste_stack global_buffers;
 int	 server_start(void);
 void	 server_update_socket(void);
+void	 server_lock_schedule(void);
 
 /* server-client.c */
 void	 server_client_create(int);
 void	 server_client_lost(struct client *);
 void	 server_client_callback(int, short, void *);
-void	 server_client_status_timer(void);
+void	 server_client_status_callback(void *);
 void	 server_client_loop(void);
 
 /* server-window.c */
+extern struct dirty_windows dirty_windows;
+void	 server_window_dirty(struct window *);
+void	 server_window_clean(void);
 void	 server_window_loop(void);
+void	 server_window_silence_schedule(struct window *);
+void	 server_window_silence_callback(void *);
 
 /* server-fn.c */
 void	 server_fill_environ(struct session *, struct environ *);
@@ -1691,8 +1919,6 @@ void	 server_update_event(struct client *);
 /* status.c */
 int	 status_out_cmp(struct status_out *, struct status_out *);
 RB_PROTOTYPE(status_out_tree, status_out, entry, status_out_cmp);
-void	 status_free_jobs(struct status_out_tree *);
-void	 status_update_jobs(struct client *);
 void	 status_set_window_at(struct client *, u_int);
 int	 status_redraw(struct client *);
 char	*status_replace(struct client *, struct session *,
@@ -1721,7 +1947,7 @@ void	 input_mouse(struct window_pane *, struct mouse_event *);
 
 /* xterm-keys.c */
 char	*xterm_keys_lookup(int);
-int	 xterm_keys_find(const char *, size_t, size_t *, int *);
+void	 xterm_keys_foreach(void (*)(const char *, int, void *), void *);
 
 /* colour.c */
 void	 colour_set_fg(struct grid_cell *, int);
@@ -1756,9 +1982,24 @@ void	 grid_clear_lines(struct grid *, u_int, u_int);
 void	 grid_move_lines(struct grid *, u_int, u_int, u_int);
 void	 grid_move_cells(struct grid *, u_int, u_int, u_int, u_int);
 char	*grid_string_cells(struct grid *, u_int, u_int, u_int);
+size_t	 grid_string_cells_buffer(
+	     struct grid *, u_int, u_int, u_int, char **, size_t *);
+size_t	 grid_string_line(struct grid *, u_int, char **, u_int **, size_t *);
 void	 grid_duplicate_lines(
 	     struct grid *, u_int, struct grid *, u_int, u_int);
 
+/* grid-index.c */
+void	 grid_index_create(struct grid *);
+void	 grid_index_destroy(struct grid *);
+void	 grid_index_update(struct grid *);
+void	 grid_index_collect(struct grid *);
+void	 grid_index_truncate(struct grid *);
+int	 grid_index_query_init(
+	     struct grid *, struct grid_index_query *, const char *, size_t);
+void	 grid_index_query_free(struct grid_index_query *);
+int	 grid_index_next(
+	     struct grid *, struct grid_index_query *, u_int, int, u_int *);
+
 /* grid-utf8.c */
 size_t	 grid_utf8_size(const struct grid_utf8 *);
 size_t	 grid_utf8_copy(const struct grid_utf8 *, char *, size_t);
@@ -1826,6 +2067,7 @@ void	 screen_write_reverseindex(struct screen_write_ctx *);
 void	 screen_write_scrollregion(struct screen_write_ctx *, u_int, u_int);
 void	 screen_write_insertmode(struct screen_write_ctx *, int);
 void	 screen_write_utf8mousemode(struct screen_write_ctx *, int);
+void	 screen_write_bracketpaste(struct screen_write_ctx *, int);
 void	 screen_write_mousemode_on(struct screen_write_ctx *, int);
 void	 screen_write_mousemode_off(struct screen_write_ctx *);
 void	 screen_write_linefeed(struct screen_write_ctx *, int);
@@ -1854,6 +2096,9 @@ void	 screen_set_cursor_style(struct screen *, u_int);
 void	 screen_set_cursor_colour(struct screen *, const char *);
 void	 screen_set_title(struct screen *, const char *);
 void	 screen_resize(struct screen *, u_int, u_int);
+void	 screen_written(struct screen *, u_int, u_int);
+void	 screen_written_scroll(struct screen *);
+void	 screen_written_reset(struct screen *);
 void	 screen_set_selection(struct screen *,
 	     u_int, u_int, u_int, u_int, u_int, struct grid_cell *);
 void	 screen_clear_selection(struct screen *);
@@ -1872,6 +2117,7 @@ int		 winlink_next_index(struct winlinks *, int);
 u_int		 winlink_count(struct winlinks *);
 struct winlink	*winlink_add(struct winlinks *, int);
 void		 winlink_set_window(struct winlink *, struct window *);
+void		 winlink_swap_windows(struct winlink *, struct winlink *);
 void		 winlink_remove(struct winlinks *, struct winlink *);
 struct winlink	*winlink_next(struct winlink *);
 struct winlink	*winlink_previous(struct winlink *);
@@ -1881,7 +2127,6 @@ struct winlink	*winlink_previous_by_number(struct winlink *, struct session *,
 		     int);
 void		 winlink_stack_push(struct winlink_stack *, struct winlink *);
 void		 winlink_stack_remove(struct winlink_stack *, struct winlink *);
-int		 window_index(struct window *, u_int *);
 struct window	*window_create1(u_int, u_int);
 struct window	*window_create(const char *, const char *, const char *,
 		     const char *, struct environ *, struct termios *,
@@ -1915,11 +2160,21 @@ int		 window_pane_set_mode(
 		     struct window_pane *, const struct window_mode *);
 void		 window_pane_reset_mode(struct window_pane *);
 void		 window_pane_key(struct window_pane *, struct session *, int);
+void		 window_pane_paste(struct window_pane *,
+		     struct paste_buffer *, const char *, int);
+void		 window_pane_paste_clear(struct window_pane *);
+void		 window_pane_write(struct window_pane *, const void *, size_t);
 void		 window_pane_mouse(struct window_pane *,
 		     struct session *, struct mouse_event *);
 int		 window_pane_visible(struct window_pane *);
-char		*window_pane_search(
-		     struct window_pane *, const char *, u_int *);
+void		 window_match_init(struct window_match *, const char *);
+void		 window_match_free(struct window_match *);
+int		 window_match_string(struct window_match *, const char *);
+struct grid_index *window_pane_get_index(struct window_pane *);
+char		*window_pane_search(struct window_pane *,
+		     struct window_match *, u_int, u_int, u_int *);
+char		*window_pane_search_history(struct window_pane *,
+		     struct window_match *, u_int *, u_int *);
 char		*window_printable_flags(struct session *, struct winlink *);
 
 struct window_pane *window_pane_find_up(struct window_pane *);
@@ -1978,6 +2233,7 @@ extern const struct window_mode window_clock_mode;
 extern const struct window_mode window_copy_mode;
 void		 window_copy_init_from_pane(struct window_pane *);
 void		 window_copy_init_for_output(struct window_pane *);
+void		 window_copy_backing_changed(struct window_pane *);
 void		 window_copy_add(struct window_pane *, const char *, ...);
 void		 window_copy_vadd(struct window_pane *, const char *, va_list);
 void		 window_copy_pageup(struct window_pane *);
@@ -1993,6 +2249,7 @@ void		 window_choose_ready(struct window_pane *,
 
 /* names.c */
 void		 queue_window_name(struct window *);
+void		 unqueue_window_name(struct window *);
 char		*default_window_name(struct window *);
 
 /* signal.c */
@@ -2026,6 +2283,7 @@ int		 session_next(struct session *, int);
 int		 session_previous(struct session *, int);
 int		 session_select(struct session *, int);
 int		 session_last(struct session *);
+void		 session_set_current(struct session *, struct winlink *);
 struct session_group *session_group_find(struct session *);
 u_int		 session_group_index(struct session_group *);
 void		 session_group_add(struct session *, struct session *);
@@ -0,0 +1,63 @@
+#!/bin/sh
+# $Id$
+#
+# Measure how long the client takes to run a command from the shell with a
+# large environment, and the server CPU time used. Two commands are timed:
+# display-message, which doesn't need the environment, and new-session, which
+# sends it. One client is attached through script(1) for display-message to
+# use. Usage:
+#
+#	bench-client.sh [tmux [runs [variables]]]
+#
+# The defaults are ./tmux, 500 runs and 500 extra variables of 50 bytes.
+# Times are from date(1) with %N, so GNU date is needed. CPU time is read from
+# /proc, so this only works on Linux.
+
+TMUX=${1:-./tmux}
+RUNS=${2:-500}
+VARIABLES=${3:-500}
+
+T="$TMUX -L bench-client-$$ -f/dev/null"
+trap "$T kill-server" 0 1 2 15
+
+ticks() {
+	awk '{ print $14 + $15 }' /proc/$PID/stat
+}
+
+# Run a command $RUNS times and print the time per run and server CPU time.
+# The output goes through a pipe: the server can't poll /dev/null.
+run() {
+	NAME=$1
+	shift
+
+	START=`ticks`
+	BEGIN=`date +%s%N`
+	i=0
+	while [ $i -lt $RUNS ]; do
+		$T "$@"
+		i=$((i + 1))
+	done | cat >/dev/null
+	END=`date +%s%N`
+	echo "$NAME: $(((END - BEGIN) / RUNS / 1000)) us per run," \
+	    "$((`ticks` - START)) ticks" >&2
+}
+
+i=0
+while [ $i -lt $VARIABLES ]; do
+	export BENCH_CLIENT_$i=`printf '%050d' $i`
+	i=$((i + 1))
+done
+echo "`env|wc -l` variables, `env|wc -c` bytes"
+
+$T new -d -s0 -x80 -y24 || exit 1
+PID=`$T server-info|sed -n '1s/.*, pid \([0-9]*\),.*/\1/p'`
+
+(
+	# Results go to stderr, stdout is the attached client's input.
+	sleep 1
+
+	run "display-message -p" display-message -p x
+	run "new-session" new-session -d -s1 \; kill-session -t1
+
+	$T detach
+) | script -qc "$T attach -t0" /dev/null >/dev/null
@@ -0,0 +1,72 @@
+#!/bin/sh
+# $Id$
+#
+# Measure server CPU time to dispatch keys typed into an attached client:
+# first plain, cursor and function keys into a pane, then keys which are not
+# bound into a pane in vi copy mode. Usage:
+#
+#	bench-keys.sh [tmux [kilobytes]]
+#
+# The defaults are ./tmux and 3072 KB of keys for each test. The client is
+# attached through script(1). CPU time is read from /proc, so this only works
+# on Linux.
+
+TMUX=${1:-./tmux}
+KB=${2:-3072}
+
+TMP=${TMPDIR:-/tmp}/bench-keys-$$
+mkdir -p $TMP || exit 1
+echo "set-window-option -g mode-keys vi" >$TMP/conf
+T="$TMUX -L bench-keys-$$ -f$TMP/conf"
+trap "$T kill-server; rm -rf $TMP" 0 1 2 15
+
+ticks() {
+	awk '{ print $14 + $15 }' /proc/$PID/stat
+}
+
+# Wait until the server has stopped using CPU.
+settle() {
+	LAST=-1
+	while [ "`ticks`" != "$LAST" ]; do
+		LAST=`ticks`
+		sleep 1
+	done
+}
+
+# Write $KB kilobytes of the strings given, in turn.
+keys() {
+	awk -v kb=$KB -v keys="$1" 'BEGIN {
+		n = split(keys, s, " ")
+		for (i = 0; size < kb * 1024; i++) {
+			printf "%s", s[i % n + 1]
+			size += length(s[i % n + 1])
+		}
+	}'
+}
+
+keys "hello\rworld\r \033[A \033[B \033[C \033[D \033OP \033[15~ \033[1;5A" \
+    >$TMP/plain
+keys "a c d i m o p r s t u x y z A C I O P Q R S T U V X Y Z" >$TMP/copy
+
+$T new -d -x80 -y24 'exec cat >/dev/null' || exit 1
+PID=`$T server-info|sed -n '1s/.*, pid \([0-9]*\),.*/\1/p'`
+
+(
+	# Results go to stderr, stdout is the attached client's input.
+	sleep 2
+	settle
+
+	START=`ticks`
+	cat $TMP/plain
+	settle
+	echo "keys into a pane: $((`ticks` - START)) ticks" >&2
+
+	$T copy-mode
+	settle
+	START=`ticks`
+	cat $TMP/copy
+	settle
+	echo "keys in vi copy mode: $((`ticks` - START)) ticks" >&2
+
+	$T detach
+) | script -qc "$T attach" /dev/null >/dev/null
@@ -0,0 +1,55 @@
+#!/bin/sh
+# $Id$
+#
+# Measure server CPU time in the main loop with many idle windows: first with
+# nothing happening, then while one pane is flooded with output. Usage:
+#
+#	bench-loop.sh [tmux [windows [lines]]]
+#
+# The defaults are ./tmux, 5000 windows and 100000 lines. One client is
+# attached through script(1) so the busy pane is drawn. CPU time is read from
+# /proc, so this only works on Linux. Each idle window has its own pty, so
+# /proc/sys/kernel/pty/max may need raising.
+
+TMUX=${1:-./tmux}
+WINDOWS=${2:-5000}
+LINES=${3:-100000}
+
+T="$TMUX -L bench-loop-$$ -f/dev/null"
+TMP=${TMPDIR:-/tmp}/bench-loop-$$
+mkdir -p $TMP || exit 1
+trap "$T kill-server; rm -rf $TMP" 0 1 2 15
+
+ticks() {
+	awk '{ print $14 + $15 }' /proc/$PID/stat
+}
+
+$T new -d -x80 -y24 || exit 1
+PID=`$T server-info|sed -n '1s/.*, pid \([0-9]*\),.*/\1/p'`
+
+i=1
+while [ $i -lt $WINDOWS ]; do
+	echo "new-window -d 'exec cat'"
+	i=$((i + 1))
+done >$TMP/windows
+$T source-file $TMP/windows
+echo "`$T list-windows|wc -l` windows"
+
+(
+	# Results go to stderr, stdout is the attached client's input.
+	sleep 2
+
+	START=`ticks`
+	sleep 5
+	echo "idle 5 s: $((`ticks` - START)) ticks" >&2
+
+	START=`ticks`
+	$T respawn-window -k -t:0 "seq $LINES; touch $TMP/done; exec cat"
+	while [ ! -f $TMP/done ]; do
+		sleep 0.1
+	done
+	sleep 1
+	echo "$LINES lines: $((`ticks` - START)) ticks" >&2
+
+	$T detach
+) | script -qc "$T attach -t:0" /dev/null >/dev/null
@@ -0,0 +1,88 @@
+#!/bin/sh
+# $Id$
+#
+# Measure server CPU time to parse and run commands given as strings:
+#
+# - sourcing a config of 5000 lines where only 20 lines are different;
+# - sourcing a config of 5000 lines which are all different;
+# - if-shell run many times with the same short command, then with the same
+#   long command. The shell command is true both times, so the difference is
+#   the cost of parsing and running the longer command.
+#
+# Usage:
+#
+#	bench-parse.sh [tmux [lines [runs]]]
+#
+# The defaults are ./tmux, 5000 lines and 20 runs. Each config is sourced runs
+# times, and if-shell is run 25 times as often. CPU time is read from /proc,
+# so this only works on Linux.
+
+TMUX=${1:-./tmux}
+LINES=${2:-5000}
+RUNS=${3:-20}
+
+T="$TMUX -L bench-parse-$$ -f/dev/null"
+TMP=${TMPDIR:-/tmp}/bench-parse-$$
+mkdir -p $TMP || exit 1
+trap "$T kill-server; rm -rf $TMP" 0 1 2 15
+
+ticks() {
+	awk '{ print $14 + $15 }' /proc/$PID/stat
+}
+
+# Wait until the server has stopped using CPU.
+settle() {
+	LAST=-1
+	while [ "`ticks`" != "$LAST" ]; do
+		LAST=`ticks`
+		sleep 1
+	done
+}
+
+# Source a file $RUNS times and print the server CPU time taken.
+run() {
+	settle
+	START=`ticks`
+	i=0
+	while [ $i -lt $RUNS ]; do
+		$T source-file $2
+		i=$((i + 1))
+	done
+	settle
+	echo "$1: $((`ticks` - START)) ticks"
+}
+
+awk -v n=$LINES 'BEGIN {
+	for (i = 0; i < n; i++)
+		printf "set-option -g status-left \"left %d\"\n", i % 20
+}' >$TMP/repeated
+awk -v n=$LINES 'BEGIN {
+	for (i = 0; i < n; i++)
+		printf "set-option -g status-left \"left %d\"\n", i
+}' >$TMP/unique
+
+# The long command is mostly has-session, which is parsed like any other but
+# costs almost nothing to run.
+LONG="has-session -t0"
+i=0
+while [ $i -lt 100 ]; do
+	LONG="$LONG ; has-session -t0"
+	i=$((i + 1))
+done
+awk -v n=$((RUNS * 25)) 'BEGIN {
+	for (i = 0; i < n; i++)
+		print "if-shell true \"has-session -t0\""
+}' >$TMP/short
+awk -v n=$((RUNS * 25)) -v cmd="$LONG" 'BEGIN {
+	for (i = 0; i < n; i++)
+		printf "if-shell true \"%s\"\n", cmd
+}' >$TMP/long
+
+$T new -d -s0 -x80 -y24 || exit 1
+$T set -g quiet on
+PID=`$T server-info|sed -n '1s/.*, pid \([0-9]*\),.*/\1/p'`
+
+run "$LINES lines, 20 different" $TMP/repeated
+run "$LINES lines, all different" $TMP/unique
+run "$((RUNS * 25)) short if-shell" $TMP/short
+run "$((RUNS * 25)) long if-shell" $TMP/long
@@ -27,16 +27,26 @@
 
 /*
  * Handle keys input from the outside terminal. tty_keys[] is a base table of
- * supported keys which are looked up in terminfo(5) and translated into a
- * ternary tree (a binary tree of binary trees).
+ * supported keys which are looked up in terminfo(5). These, the xterm-style
+ * keys with modifiers and the start of a mouse sequence are compiled into a
+ * table of states, one row for each prefix of a key and one column for each
+ * byte used in any key. Finding a key is then one table lookup per byte. The
+ * table depends only on the terminal so is shared by all ttys using it.
  */
 
-void		tty_keys_add1(struct tty_key **, const char *, int);
-void		tty_keys_add(struct tty *, const char *, int);
-void		tty_keys_free1(struct tty_key *);
-struct tty_key *tty_keys_find1(
-		    struct tty_key *, const char *, size_t, size_t *);
-struct tty_key *tty_keys_find(struct tty *, const char *, size_t, size_t *);
+/* A key sequence to be added to the table. */
+struct tty_keys_seq {
+	char	*s;
+	int	 key;
+	int	 flags;
+};
+ARRAY_DECL(tty_keys_list, struct tty_keys_seq);
+
+void		tty_keys_add(struct tty_keys_list *, const char *, int, int);
+void		tty_keys_add_xterm(const char *, int, void *);
+struct tty_key_table *tty_keys_build(struct tty_keys_list *);
+u_int		tty_keys_find(
+		    struct tty_key_table *, const char *, size_t, size_t *);
 void		tty_keys_callback(int, short, void *);
 int		tty_keys_mouse(struct tty *,
 		    const char *, size_t, size_t *, struct mouse_event *);
@@ -284,144 +294,189 @@ const struct tty_key_ent tty_keys[] = {
 	{ TTYC_KUP7,	NULL,		KEYC_UP|KEYC_ESCAPE|KEYC_CTRL, 0 },
 };
 
+/* Add a key sequence to the list, replacing any existing key. */
 void
-tty_keys_add(struct tty *tty, const char *s, int key)
+tty_keys_add(struct tty_keys_list *list, const char *s, int key, int flags)
 {
-	struct tty_key	*tk;
-	size_t		 size;
-	const char     	*keystr;
+	struct tty_keys_seq	*seq;
+	const char		*keystr;
+	u_int			 i;
 
 	keystr = key_string_lookup_key(key);
-	if ((tk = tty_keys_find(tty, s, strlen(s), &size)) == NULL) {
-		log_debug("new key %s: 0x%x (%s)", s, key, keystr);
-		tty_keys_add1(&tty->key_tree, s, key);
-	} else {
-		log_debug("replacing key %s: 0x%x (%s)", s, key, keystr);
-		tk->key = key;
+	for (i = 0; i < ARRAY_LENGTH(list); i++) {
+		seq = &ARRAY_ITEM(list, i);
+		if (strcmp(seq->s, s) == 0) {
+			log_debug("replacing key %s: 0x%x (%s)", s, key, keystr);
+			seq->key = key;
+			seq->flags = flags;
+			return;
+		}
 	}
+	log_debug("new key %s: 0x%x (%s)", s, key, keystr);
+
+	ARRAY_EXPAND(list, 1);
+	seq = &ARRAY_LAST(list);
+	seq->s = xstrdup(s);
+	seq->key = key;
+	seq->flags = flags;
 }
 
-/* Add next node to the tree. */
+/* Add an xterm key sequence, without the leading escape. */
 void
-tty_keys_add1(struct tty_key **tkp, const char *s, int key)
+tty_keys_add_xterm(const char *s, int key, void *data)
 {
-	struct tty_key	*tk;
-
-	/* Allocate a tree entry if there isn't one already. */
-	tk = *tkp;
-	if (tk == NULL) {
-		tk = *tkp = xcalloc(1, sizeof *tk);
-		tk->ch = *s;
-		tk->key = KEYC_NONE;
-	}
-
-	/* Find the next entry. */
-	if (*s == tk->ch) {
-		/* Move forward in string. */
-		s++;
-
-		/* If this is the end of the string, no more is necessary. */
-		if (*s == '\0') {
-			tk->key = key;
-			return;
-		}
-
-		/* Use the child tree for the next character. */
-		tkp = &tk->next;
-	} else {
-		if (*s < tk->ch)
-			tkp = &tk->left;
-		else if (*s > tk->ch)
-			tkp = &tk->right;
-	}
-
-	/* And recurse to add it. */
-	tty_keys_add1(tkp, s, key);
+	tty_keys_add(data, s + 1, key, 0);
 }
 
-/* Initialise a key tree from the table. */
+/* Initialise the key table for a tty, if its terminal doesn't have one yet. */
 void
 tty_keys_init(struct tty *tty)
 {
+	struct tty_term			*term = tty->term;
 	const struct tty_key_ent	*tke;
+	struct tty_keys_list		 list;
 	u_int		 		 i;
 	const char			*s;
 
-	tty->key_tree = NULL;
+	if (term->keys != NULL)
+		return;
+
+	ARRAY_INIT(&list);
 	for (i = 0; i < nitems(tty_keys); i++) {
 		tke = &tty_keys[i];
 
 		if (tke->flags & TTYKEY_RAW)
 			s = tke->string;
 		else {
-			if (!tty_term_has(tty->term, tke->code))
+			if (!tty_term_has(term, tke->code))
 				continue;
-			s = tty_term_string(tty->term, tke->code);
+			s = tty_term_string(term, tke->code);
 		}
 		if (s[0] != '\033' || s[1] == '\0')
 			continue;
 
-		tty_keys_add(tty, s + 1, tke->key);
+		tty_keys_add(&list, s + 1, tke->key, 0);
 	}
+
+	/*
+	 * xterm-style keys and mouse sequences are checked before the keys
+	 * above, so they replace any with the same string.
+	 */
+	xterm_keys_foreach(tty_keys_add_xterm, &list);
+	tty_keys_add(&list, "[M", KEYC_MOUSE, TTY_KEY_MOUSE);
+
+	term->keys = tty_keys_build(&list);
+
+	for (i = 0; i < ARRAY_LENGTH(&list); i++)
+		xfree(ARRAY_ITEM(&list, i).s);
+	ARRAY_FREE(&list);
 }
 
-/* Free the entire key tree. */
-void
-tty_keys_free(struct tty *tty)
+/* Build the table of states from a list of key sequences. */
+struct tty_key_table *
+tty_keys_build(struct tty_keys_list *list)
 {
-	tty_keys_free1(tty->key_tree);
+	struct tty_key_table	*tkt;
+	struct tty_keys_seq	*seq;
+	const u_char		*ptr;
+	u_short			*next;
+	u_int			 i, state, size;
+
+	tkt = xcalloc(1, sizeof *tkt);
+
+	/*
+	 * Give each byte which appears in a sequence its own class. All other
+	 * bytes are in class 0, which never leads anywhere.
+	 */
+	tkt->nclasses = 1;
+	size = 1;
+	for (i = 0; i < ARRAY_LENGTH(list); i++) {
+		seq = &ARRAY_ITEM(list, i);
+		for (ptr = seq->s; *ptr != '\0'; ptr++) {
+			if (tkt->classes[*ptr] == 0)
+				tkt->classes[*ptr] = tkt->nclasses++;
+			size++;
+		}
+	}
+
+	/*
+	 * There can be no more states than bytes in the sequences, plus the
+	 * first. State 0 is the first and can't be reached from any other, so
+	 * 0 in the table means no match.
+	 */
+	tkt->next = xcalloc(size * tkt->nclasses, sizeof *tkt->next);
+	tkt->keys = xcalloc(size, sizeof *tkt->keys);
+	tkt->flags = xcalloc(size, sizeof *tkt->flags);
+	tkt->nstates = 1;
+	tkt->keys[0] = KEYC_NONE;
+
+	for (i = 0; i < ARRAY_LENGTH(list); i++) {
+		seq = &ARRAY_ITEM(list, i);
+
+		state = 0;
+		for (ptr = seq->s; *ptr != '\0'; ptr++) {
+			tkt->flags[state] |= TTY_KEY_PARTIAL;
+
+			next = &tkt->next[
+			    state * tkt->nclasses + tkt->classes[*ptr]];
+			if (*next == 0) {
+				*next = tkt->nstates++;
+				tkt->keys[*next] = KEYC_NONE;
+			}
+			state = *next;
+		}
+		tkt->keys[state] = seq->key;
+		tkt->flags[state] |= seq->flags;
+	}
+	log_debug("%u key states, %u classes", tkt->nstates, tkt->nclasses);
+
+	tkt->next = xrealloc(tkt->next,
+	    tkt->nstates * tkt->nclasses, sizeof *tkt->next);
+	tkt->keys = xrealloc(tkt->keys, tkt->nstates, sizeof *tkt->keys);
+	tkt->flags = xrealloc(tkt->flags, tkt->nstates, sizeof *tkt->flags);
+	return (tkt);
 }
 
-/* Free a single key. */
+/* Free a terminal's key table. */
 void
-tty_keys_free1(struct tty_key *tk)
+tty_keys_free(struct tty_term *term)
 {
-	if (tk->next != NULL)
-		tty_keys_free1(tk->next);
-	if (tk->left != NULL)
-		tty_keys_free1(tk->left);
-	if (tk->right != NULL)
-		tty_keys_free1(tk->right);
-	xfree(tk);
-}
+	struct tty_key_table	*tkt = term->keys;
 
-/* Lookup a key in the tree. */
-struct tty_key *
-tty_keys_find(struct tty *tty, const char *buf, size_t len, size_t *size)
-{
-	*size = 0;
-	return (tty_keys_find1(tty->key_tree, buf, len, size));
+	if (tkt == NULL)
+		return;
+	xfree(tkt->next);
+	xfree(tkt->keys);
+	xfree(tkt->flags);
+	xfree(tkt);
+	term->keys = NULL;
 }
 
-/* Find the next node. */
-struct tty_key *
-tty_keys_find1(struct tty_key *tk, const char *buf, size_t len, size_t *size)
+/*
+ * Look up a key sequence (after the escape) at the start of a buffer. Stops
+ * at the end of the buffer, at a mouse sequence, or at a key with no longer
+ * sequences after it. Returns the state reached and its length, or 0 if there
+ * is no match.
+ */
+u_int
+tty_keys_find(struct tty_key_table *tkt, const char *buf, size_t len,
+    size_t *size)
 {
-	/* If the node is NULL, this is the end of the tree. No match. */
-	if (tk == NULL)
-		return (NULL);
-
-	/* Pick the next in the sequence. */
-	if (tk->ch == *buf) {
-		/* Move forward in the string. */
-		buf++; len--;
-		(*size)++;
-
-		/* At the end of the string, return the current node. */
-		if (len == 0 || (tk->next == NULL && tk->key != KEYC_NONE))
-			return (tk);
-
-		/* Move into the next tree for the following character. */
-		tk = tk->next;
-	} else {
-		if (*buf < tk->ch)
-			tk = tk->left;
-		else if (*buf > tk->ch)
-			tk = tk->right;
-	}
+	const u_char	*ptr = buf;
+	u_int		 state, class;
 
-	/* Move to the next in the tree. */
-	return (tty_keys_find1(tk, buf, len, size));
+	state = 0;
+	*size = 0;
+	while (*size < len) {
+		class = tkt->classes[ptr[(*size)++]];
+		if ((state = tkt->next[state * tkt->nclasses + class]) == 0)
+			return (0);
+		if (tkt->flags[state] & TTY_KEY_MOUSE)
+			break;
+		if (!(tkt->flags[state] & TTY_KEY_PARTIAL))
+			break;
+	}
+	return (state);
 }
 
 /*
@@ -431,12 +486,13 @@ tty_keys_find1(struct tty_key *tk, const char *buf, size_t len, size_t *size)
 int
 tty_keys_next(struct tty *tty)
 {
-	struct tty_key		*tk;
+	struct tty_key_table	*tkt = tty->term->keys;
 	struct timeval		 tv;
 	struct mouse_event	 mouse;
 	const char		*buf;
 	size_t			 len, size;
 	cc_t			 bspace;
+	u_int			 state;
 	int			 key, delay;
 
 	buf = EVBUFFER_DATA(tty->event->input);
@@ -461,33 +517,28 @@ tty_keys_next(struct tty *tty)
 		goto handle_key;
 	}
 
-	/* Is this a mouse key press? */
-	switch (tty_keys_mouse(tty, buf, len, &size, &mouse)) {
-	case 0:		/* yes */
-		evbuffer_drain(tty->event->input, size);
-		key = KEYC_MOUSE;
-		goto handle_key;
-	case -1:	/* no, or not valid */
-		break;
-	case 1:		/* partial */
-		goto partial_key;
-	}
-
-	/* Try to parse a key with an xterm-style modifier. */
-	switch (xterm_keys_find(buf, len, &size, &key)) {
-	case 0:		/* found */
-		evbuffer_drain(tty->event->input, size);
-		goto handle_key;
-	case -1:	/* not found */
-		break;
-	case 1:
+	/* An escape alone may be the start of a key. */
+	if (len == 1)
 		goto partial_key;
-	}
 
 	/* Look for matching key string and return if found. */
-	tk = tty_keys_find(tty, buf + 1, len - 1, &size);
-	if (tk != NULL) {
-		key = tk->key;
+	state = tty_keys_find(tkt, buf + 1, len - 1, &size);
+	if (state != 0 && tkt->flags[state] & TTY_KEY_MOUSE) {
+		/* Is this a mouse key press? */
+		switch (tty_keys_mouse(tty, buf, len, &size, &mouse)) {
+		case 0:		/* yes */
+			evbuffer_drain(tty->event->input, size);
+			key = KEYC_MOUSE;
+			goto handle_key;
+		case -1:	/* no, or not valid */
+			state = 0;
+			break;
+		case 1:		/* partial */
+			goto partial_key;
+		}
+	}
+	if (state != 0) {
+		key = tkt->keys[state];
 		goto found_key;
 	}
 
@@ -504,9 +555,9 @@ tty_keys_next(struct tty *tty)
 
 	/* Or a key string? */
 	if (len > 1) {
-		tk = tty_keys_find(tty, buf + 1, len - 1, &size);
-		if (tk != NULL) {
-			key = tk->key | KEYC_ESCAPE;
+		state = tty_keys_find(tkt, buf + 1, len - 1, &size);
+		if (state != 0 && !(tkt->flags[state] & TTY_KEY_MOUSE)) {
+			key = tkt->keys[state] | KEYC_ESCAPE;
 			size++;	/* include escape */
 			goto found_key;
 		}
@@ -541,13 +592,13 @@ start_timer:
 	return (0);
 
 found_key:
-	if (tk->next != NULL) {
+	if (tkt->flags[state] & TTY_KEY_PARTIAL) {
 		/* Partial key. Start the timer if not already expired. */
 		if (!(tty->flags & TTY_ESCAPE))
 			goto start_timer;
 
 		/* Otherwise, if no key, send the escape alone. */
-		if (tk->key == KEYC_NONE)
+		if (tkt->keys[state] == KEYC_NONE)
 			goto partial_key;
 
 		/* Or fall through to send the partial key found. */
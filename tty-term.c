@@ -330,6 +330,7 @@ tty_term_find(char *name, int fd, const char *overrides, char **cause)
 	term->references = 1;
 	term->flags = 0;
 	memset(term->codes, 0, sizeof term->codes);
+	term->keys = NULL;
 	LIST_INSERT_HEAD(&tty_terms, term, entry);
 
 	/* Set up curses terminal. */
@@ -469,6 +470,7 @@ tty_term_free(struct tty_term *term)
 		if (term->codes[i].type == TTYCODE_STRING)
 			xfree(term->codes[i].value.string);
 	}
+	tty_keys_free(term);
 	xfree(term->name);
 	xfree(term);
 }
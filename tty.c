@@ -275,7 +275,6 @@ tty_close(struct tty *tty)
 		bufferevent_free(tty->event);
 
 		tty_term_free(tty->term);
-		tty_keys_free(tty);
 
 		tty->flags &= ~TTY_OPENED;
 	}
@@ -508,6 +507,7 @@ tty_redraw_region(struct tty *tty, const struct tty_ctx *ctx)
 	 */
 	if (ctx->orlower - ctx->orupper >= screen_size_y(s) / 2) {
 		wp->flags |= PANE_REDRAW;
+		server_window_dirty(wp->window);
 		return;
 	}
 
@@ -590,7 +590,6 @@ tty_write(void (*cmdfn)(
 {
 	struct window_pane	*wp = ctx->wp;
 	struct client		*c;
-	u_int		 	 i;
 
 	/* wp can be NULL if updating the screen but not the terminal. */
 	if (wp == NULL)
@@ -600,10 +599,10 @@ tty_write(void (*cmdfn)(
 		return;
 	if (!window_pane_visible(wp))
 		return;
+	server_window_dirty(wp->window);
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c == NULL || c->session == NULL)
+	TAILQ_FOREACH(c, &clients, entry) {
+		if (c->session == NULL)
 			continue;
 		if (c->flags & CLIENT_SUSPENDED)
 			continue;
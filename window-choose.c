@@ -42,7 +42,6 @@ const struct window_mode window_choose_mode = {
 	window_choose_resize,
 	window_choose_key,
 	window_choose_mouse,
-	NULL,
 };
 
 struct window_choose_mode_item {
@@ -27,7 +27,8 @@ struct screen *window_clock_init(struct window_pane *);
 void	window_clock_free(struct window_pane *);
 void	window_clock_resize(struct window_pane *, u_int, u_int);
 void	window_clock_key(struct window_pane *, struct session *, int);
-void	window_clock_timer(struct window_pane *);
+void	window_clock_timer(void *);
+void	window_clock_schedule(struct window_pane *);
 
 void	window_clock_draw_screen(struct window_pane *);
 
@@ -37,12 +38,12 @@ const struct window_mode window_clock_mode = {
 	window_clock_resize,
 	window_clock_key,
 	NULL,
-	window_clock_timer,
 };
 
 struct window_clock_mode_data {
 	struct screen	        screen;
 	time_t			tim;
+	struct timer		timer;
 };
 
 struct screen *
@@ -53,6 +54,8 @@ window_clock_init(struct window_pane *wp)
 
 	wp->modedata = data = xmalloc(sizeof *data);
 	data->tim = time(NULL);
+	timer_set(&data->timer, window_clock_timer, wp);
+	window_clock_schedule(wp);
 
 	s = &data->screen;
 	screen_init(s, screen_size_x(&wp->base), screen_size_y(&wp->base), 0);
@@ -68,6 +71,7 @@ window_clock_free(struct window_pane *wp)
 {
 	struct window_clock_mode_data	*data = wp->modedata;
 
+	timer_del(&data->timer);
 	screen_free(&data->screen);
 	xfree(data);
 }
@@ -90,13 +94,27 @@ window_clock_key(
 	window_pane_reset_mode(wp);
 }
 
+/* Set the timer for the start of the next minute. */
 void
-window_clock_timer(struct window_pane *wp)
+window_clock_schedule(struct window_pane *wp)
 {
+	struct window_clock_mode_data	*data = wp->modedata;
+	time_t				 t;
+
+	t = time(NULL);
+	timer_add(&data->timer, t - (t % 60) + 60);
+}
+
+void
+window_clock_timer(void *arg)
+{
+	struct window_pane		*wp = arg;
 	struct window_clock_mode_data	*data = wp->modedata;
 	struct tm			 now, then;
 	time_t				 t;
 
+	window_clock_schedule(wp);
+
 	t = time(NULL);
 	gmtime_r(&t, &now);
 	gmtime_r(&data->tim, &then);
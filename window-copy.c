@@ -18,6 +18,7 @@
 
 #include <sys/types.h>
 
+#include <regex.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -36,26 +37,38 @@ void	window_copy_redraw_lines(struct window_pane *, u_int, u_int);
 void	window_copy_redraw_screen(struct window_pane *);
 void	window_copy_write_line(
 	    struct window_pane *, struct screen_write_ctx *, u_int);
+void	window_copy_write_mark(struct window_pane *,
+	    struct screen_write_ctx *, u_int, struct grid_cell *, u_int);
 void	window_copy_write_lines(
 	    struct window_pane *, struct screen_write_ctx *, u_int, u_int);
 
 void	window_copy_scroll_to(struct window_pane *, u_int, u_int);
-int	window_copy_search_compare(
-	    struct grid *, u_int, u_int, struct grid *, u_int);
+int	window_copy_search_start(struct window_pane *, const char *);
+void	window_copy_search_end(struct window_pane *);
+int	window_copy_search_position(struct window_pane *);
+void	window_copy_search_run(struct window_pane *);
+void	window_copy_search_callback(int, short, void *);
+void	window_copy_search_unmark(struct window_pane *);
+void	window_copy_search_fill(struct window_pane *, u_int);
+int	window_copy_search_next(
+	    struct window_pane *, size_t, size_t *, size_t *);
 int	window_copy_search_lr(
-	    struct grid *, struct grid *, u_int *, u_int, u_int, u_int);
+	    struct window_pane *, u_int *, u_int *, u_int, u_int, u_int);
 int	window_copy_search_rl(
-	    struct grid *, struct grid *, u_int *, u_int, u_int, u_int);
-void	window_copy_search_up(struct window_pane *, const char *);
-void	window_copy_search_down(struct window_pane *, const char *);
+	    struct window_pane *, u_int *, u_int *, u_int, u_int, u_int);
+void	window_copy_search(struct window_pane *, const char *, int, u_int);
+void	window_copy_search_up(struct window_pane *, const char *, u_int);
+void	window_copy_search_down(struct window_pane *, const char *, u_int);
 void	window_copy_goto_line(struct window_pane *, const char *);
 void	window_copy_update_cursor(struct window_pane *, u_int, u_int);
 void	window_copy_start_selection(struct window_pane *);
 int	window_copy_update_selection(struct window_pane *);
 void	window_copy_copy_selection(struct window_pane *);
 void	window_copy_clear_selection(struct window_pane *);
-void	window_copy_copy_line(
-	    struct window_pane *, char **, size_t *, u_int, u_int, u_int);
+size_t	window_copy_copy_lines(struct window_pane *, char *,
+	    u_int, u_int, u_int, u_int, u_int, u_int);
+size_t	window_copy_copy_line(
+	    struct window_pane *, char *, u_int, u_int, u_int);
 int	window_copy_in_set(struct window_pane *, u_int, u_int, const char *);
 u_int	window_copy_find_length(struct window_pane *, u_int);
 void	window_copy_cursor_start_of_line(struct window_pane *);
@@ -80,7 +93,6 @@ const struct window_mode window_copy_mode = {
 	window_copy_resize,
 	window_copy_key,
 	window_copy_mouse,
-	NULL,
 };
 
 enum window_copy_input_type {
@@ -93,6 +105,47 @@ enum window_copy_input_type {
 	WINDOW_COPY_GOTOLINE,
 };
 
+/* Number of lines to search before returning to the event loop. */
+#define WINDOW_COPY_SEARCH_LINES 10000
+
+/*
+ * Search state. Each line is searched as a string of bytes, with the cell
+ * each byte came from kept alongside so a match can be turned back into a
+ * position on the screen.
+ *
+ * Long searches are done a slice of lines at a time from a timer so that the
+ * server is not blocked; str is non-NULL while a search is running.
+ */
+struct window_copy_search {
+	char	       *str;
+	size_t		len;
+	int		regex;
+	regex_t		re;
+
+	int		indexed;	/* history lines found from index */
+	struct grid_index_query query;
+
+	int		up;
+	u_int		count;	/* matches left to find */
+	u_int		py;	/* next line to search */
+	u_int		px;	/* limit on the first line */
+	int		partial; /* next line is the first line */
+	u_int		left;	/* lines left to search */
+	u_int		total;	/* lines in the grid when started */
+	struct event	timer;
+
+	/* Last match found, highlighted until the next key. */
+	int		marked;
+	u_int		markx;
+	u_int		marky;
+	u_int		markn;
+
+	char	       *buf;	/* bytes of the line being searched */
+	u_int	       *cols;	/* cell each byte starts in */
+	size_t		buflen;
+	size_t		bufsize;
+};
+
 /*
  * Copy-mode's visible screen (the "screen" field) is filled from one of
  * two sources: the original contents of the pane (used when we
@@ -108,12 +161,19 @@ enum window_copy_input_type {
  * when backed by a list of output-lines from a command, it points at
  * a newly-allocated screen structure (which is deallocated when the
  * mode ends).
+ *
+ * The pane keeps running while in copy mode. As its output pushes lines into
+ * the history, the offset from the bottom (oy) is increased so the same lines
+ * stay in view; lines collected from the top of the history move the
+ * selection up with them.
  */
 struct window_copy_mode_data {
 	struct screen	screen;
 
 	struct screen  *backing;
 	int		backing_written; /* backing display has started */
+	u_int		backing_end;	/* history lines seen from the pane */
+	u_int		backing_collected; /* and collected from its top */
 
 	struct mode_key_data mdata;
 
@@ -138,9 +198,12 @@ struct window_copy_mode_data {
 
 	enum window_copy_input_type searchtype;
 	char	       *searchstr;
+	struct window_copy_search search;
 
 	enum window_copy_input_type jumptype;
 	char		jumpchar;
+
+	char	       *errorstr; /* shown in place of position until a key */
 };
 
 struct screen *
@@ -169,14 +232,14 @@ window_copy_init(struct window_pane *wp)
 
 	data->searchtype = WINDOW_COPY_OFF;
 	data->searchstr = NULL;
-
-	wp->flags |= PANE_FREEZE;
-	if (wp->fd != -1)
-		bufferevent_disable(wp->event, EV_READ|EV_WRITE);
+	memset(&data->search, 0, sizeof data->search);
+	evtimer_set(&data->search.timer, window_copy_search_callback, wp);
 
 	data->jumptype = WINDOW_COPY_OFF;
 	data->jumpchar = '\0';
 
+	data->errorstr = NULL;
+
 	s = &data->screen;
 	screen_init(s, screen_size_x(&wp->base), screen_size_y(&wp->base), 0);
 	if (options_get_number(&wp->window->options, "mode-mouse"))
@@ -205,6 +268,8 @@ window_copy_init_from_pane(struct window_pane *wp)
 		fatalx("not in copy mode");
 
 	data->backing = &wp->base;
+	data->backing_end = wp->base.grid->hcollected + wp->base.grid->hsize;
+	data->backing_collected = wp->base.grid->hcollected;
 	data->cx = data->backing->cx;
 	data->cy = data->backing->cy;
 
@@ -234,13 +299,17 @@ window_copy_free(struct window_pane *wp)
 {
 	struct window_copy_mode_data	*data = wp->modedata;
 
-	wp->flags &= ~PANE_FREEZE;
-	if (wp->fd != -1)
-		bufferevent_enable(wp->event, EV_READ|EV_WRITE);
-
 	if (data->searchstr != NULL)
 		xfree(data->searchstr);
+	if (data->search.str != NULL)
+		window_copy_search_end(wp);
+	if (data->search.buf != NULL) {
+		xfree(data->search.buf);
+		xfree(data->search.cols);
+	}
 	xfree(data->inputstr);
+	if (data->errorstr != NULL)
+		xfree(data->errorstr);
 
 	if (data->backing != &wp->base) {
 		screen_free(data->backing);
@@ -344,6 +413,9 @@ window_copy_resize(struct window_pane *wp, u_int sx, u_int sy)
 		data->cx = sx;
 	if (data->oy > screen_hsize(data->backing))
 		data->oy = screen_hsize(data->backing);
+	data->backing_end =
+	    data->backing->grid->hcollected + screen_hsize(data->backing);
+	data->backing_collected = data->backing->grid->hcollected;
 
 	window_copy_clear_selection(wp);
 
@@ -354,6 +426,73 @@ window_copy_resize(struct window_pane *wp, u_int sx, u_int sy)
 	window_copy_redraw_screen(wp);
 }
 
+/*
+ * The pane has written to its screen while in copy mode. Keep the same lines
+ * in view and the selection and any search on the same lines, then redraw.
+ */
+void
+window_copy_backing_changed(struct window_pane *wp)
+{
+	struct window_copy_mode_data	*data = wp->modedata;
+	struct window_copy_search	*ws = &data->search;
+	struct grid			*gd = wp->base.grid;
+	u_int				 end, added, collected, oy;
+
+	if (data->backing != &wp->base)
+		return;
+
+	end = gd->hcollected + gd->hsize;
+	added = 0;
+	if (end > data->backing_end)
+		added = end - data->backing_end;
+	collected = gd->hcollected - data->backing_collected;
+	data->backing_end = end;
+	data->backing_collected = gd->hcollected;
+
+	/* Move down the history by the lines added, unless they ran out. */
+	oy = data->oy + added;
+	if (oy > gd->hsize)
+		oy = gd->hsize;
+
+	if (collected != 0) {
+		if (data->sely > collected)
+			data->sely -= collected;
+		else
+			data->sely = 0;
+
+		if (ws->marked) {
+			if (ws->marky < collected)
+				ws->marked = 0;
+			else
+				ws->marky -= collected;
+		}
+
+		if (ws->str != NULL) {
+			if (ws->py < collected)
+				window_copy_search_end(wp);
+			else
+				ws->py -= collected;
+		}
+	}
+	if (ws->str != NULL)
+		ws->total = gd->hsize + gd->sy;
+
+	/*
+	 * If only history is shown and it is the same lines, only the
+	 * position in the first line has changed.
+	 */
+	if (oy == data->oy + added && oy >= screen_size_y(&data->screen)) {
+		data->oy = oy;
+		if (added != 0 || collected != 0)
+			window_copy_redraw_lines(wp, 0, 1);
+		return;
+	}
+	data->oy = oy;
+
+	window_copy_update_selection(wp);
+	window_copy_redraw_screen(wp);
+}
+
 void
 window_copy_key(struct window_pane *wp, struct session *sess, int key)
 {
@@ -364,6 +503,20 @@ window_copy_key(struct window_pane *wp, struct session *sess, int key)
 	int				 keys;
 	enum mode_key_cmd		 cmd;
 
+	/* Any key cancels a running search. */
+	if (data->search.str != NULL) {
+		window_copy_search_end(wp);
+		window_copy_redraw_lines(wp, 0, 1);
+		return;
+	}
+	if (data->search.marked)
+		window_copy_search_unmark(wp);
+	if (data->errorstr != NULL) {
+		xfree(data->errorstr);
+		data->errorstr = NULL;
+		window_copy_redraw_lines(wp, 0, 1);
+	}
+
 	np = data->numprefix;
 	if (np == 0)
 		np = 1;
@@ -618,30 +771,19 @@ window_copy_key(struct window_pane *wp, struct session *sess, int key)
 		case WINDOW_COPY_NUMERICPREFIX:
 			break;
 		case WINDOW_COPY_SEARCHUP:
-			if (cmd == MODEKEYCOPY_SEARCHAGAIN) {
-				for (; np != 0; np--) {
-					window_copy_search_up(
-					    wp, data->searchstr);
-				}
-			} else {
-				for (; np != 0; np--) {
-					window_copy_search_down(
-					    wp, data->searchstr);
-				}
+			if (cmd == MODEKEYCOPY_SEARCHAGAIN)
+				window_copy_search_up(wp, data->searchstr, np);
+			else {
+				window_copy_search_down(
+				    wp, data->searchstr, np);
 			}
 			break;
 		case WINDOW_COPY_SEARCHDOWN:
 			if (cmd == MODEKEYCOPY_SEARCHAGAIN) {
-				for (; np != 0; np--) {
-					window_copy_search_down(
-					    wp, data->searchstr);
-				}
-			} else {
-				for (; np != 0; np--) {
-					window_copy_search_up(
-					    wp, data->searchstr);
-				}
-			}
+				window_copy_search_down(
+				    wp, data->searchstr, np);
+			} else
+				window_copy_search_up(wp, data->searchstr, np);
 			break;
 		}
 		break;
@@ -724,14 +866,12 @@ window_copy_key_input(struct window_pane *wp, int key)
 		case WINDOW_COPY_NUMERICPREFIX:
 			break;
 		case WINDOW_COPY_SEARCHUP:
-			for (; np != 0; np--)
-				window_copy_search_up(wp, data->inputstr);
+			window_copy_search_up(wp, data->inputstr, np);
 			data->searchtype = data->inputtype;
 			data->searchstr = xstrdup(data->inputstr);
 			break;
 		case WINDOW_COPY_SEARCHDOWN:
-			for (; np != 0; np--)
-				window_copy_search_down(wp, data->inputstr);
+			window_copy_search_down(wp, data->inputstr, np);
 			data->searchtype = data->inputtype;
 			data->searchstr = xstrdup(data->inputstr);
 			break;
@@ -867,187 +1007,367 @@ window_copy_scroll_to(struct window_pane *wp, u_int px, u_int py)
 	window_copy_redraw_screen(wp);
 }
 
+/*
+ * Prepare to search for a string, compiling it if the mode-search-regex
+ * option is set.
+ */
 int
-window_copy_search_compare(
-    struct grid *gd, u_int px, u_int py, struct grid *sgd, u_int spx)
+window_copy_search_start(struct window_pane *wp, const char *searchstr)
 {
-	const struct grid_cell	*gc, *sgc;
-	const struct grid_utf8	*gu, *sgu;
+	struct window_copy_mode_data	*data = wp->modedata;
+	struct window_copy_search	*ws = &data->search;
+	char				 errbuf[128];
+	int				 error;
 
-	gc = grid_peek_cell(gd, px, py);
-	sgc = grid_peek_cell(sgd, spx, 0);
+	if (*searchstr == '\0')
+		return (-1);
 
-	if ((gc->flags & GRID_FLAG_UTF8) != (sgc->flags & GRID_FLAG_UTF8))
-		return (0);
+	ws->regex = options_get_number(
+	    &wp->window->options, "mode-search-regex");
+	if (ws->regex) {
+		error = regcomp(&ws->re, searchstr, REG_EXTENDED|REG_NEWLINE);
+		if (error != 0) {
+			regerror(error, &ws->re, errbuf, sizeof errbuf);
+			if (data->errorstr != NULL)
+				xfree(data->errorstr);
+			xasprintf(&data->errorstr, "Bad regex: %s", errbuf);
+			window_copy_redraw_lines(wp, 0, 1);
+			return (-1);
+		}
+	}
 
-	if (gc->flags & GRID_FLAG_UTF8) {
-		gu = grid_peek_utf8(gd, px, py);
-		sgu = grid_peek_utf8(sgd, spx, 0);
-		if (grid_utf8_compare(gu, sgu))
-			return (1);
-	} else {
-		if (gc->data == sgc->data)
-			return (1);
+	ws->str = xstrdup(searchstr);
+	ws->len = strlen(searchstr);
+
+	/* Plain strings in the pane history can be found from its index. */
+	ws->indexed = 0;
+	if (!ws->regex && data->backing == &wp->base &&
+	    window_pane_get_index(wp) != NULL) {
+		if (grid_index_query_init(data->backing->grid,
+		    &ws->query, ws->str, ws->len) == 0)
+			ws->indexed = 1;
 	}
 	return (0);
 }
 
-int
-window_copy_search_lr(struct grid *gd,
-    struct grid *sgd, u_int *ppx, u_int py, u_int first, u_int last)
+/* Finish or cancel a search. */
+void
+window_copy_search_end(struct window_pane *wp)
 {
-	u_int	ax, bx, px;
+	struct window_copy_mode_data	*data = wp->modedata;
+	struct window_copy_search	*ws = &data->search;
 
-	for (ax = first; ax < last; ax++) {
-		if (ax + sgd->sx >= gd->sx)
-			break;
-		for (bx = 0; bx < sgd->sx; bx++) {
-			px = ax + bx;
-			if (!window_copy_search_compare(gd, px, py, sgd, bx))
-				break;
-		}
-		if (bx == sgd->sx) {
-			*ppx = ax;
-			return (1);
-		}
-	}
-	return (0);
+	evtimer_del(&ws->timer);
+
+	if (ws->indexed)
+		grid_index_query_free(&ws->query);
+	if (ws->regex)
+		regfree(&ws->re);
+	xfree(ws->str);
+	ws->str = NULL;
 }
 
+/*
+ * Set up to search from just after (or before if searching up) the cursor,
+ * through the whole grid and back to the cursor line.
+ */
 int
-window_copy_search_rl(struct grid *gd,
-    struct grid *sgd, u_int *ppx, u_int py, u_int first, u_int last)
+window_copy_search_position(struct window_pane *wp)
 {
-	u_int	ax, bx, px;
+	struct window_copy_mode_data	*data = wp->modedata;
+	struct window_copy_search	*ws = &data->search;
+	struct grid			*gd = data->backing->grid;
+	u_int				 fx, fy;
 
-	for (ax = last + 1; ax > first; ax--) {
-		if (gd->sx - (ax - 1) < sgd->sx)
-			continue;
-		for (bx = 0; bx < sgd->sx; bx++) {
-			px = ax - 1 + bx;
-			if (!window_copy_search_compare(gd, px, py, sgd, bx))
-				break;
-		}
-		if (bx == sgd->sx) {
-			*ppx = ax - 1;
-			return (1);
-		}
+	fx = data->cx;
+	fy = gd->hsize - data->oy + data->cy;
+
+	if (ws->up) {
+		if (fx == 0) {
+			if (fy == 0)
+				return (-1);
+			fx = gd->sx - 1;
+			fy--;
+		} else
+			fx--;
+	} else {
+		if (fx == gd->sx - 1) {
+			fx = 0;
+			if (++fy == ws->total)
+				fy = 0;
+		} else
+			fx++;
 	}
+
+	ws->px = fx;
+	ws->py = fy;
+	ws->partial = 1;
+	ws->left = ws->total + 1;
 	return (0);
 }
 
+/*
+ * Search a slice of lines. If a match is found the cursor is moved to it;
+ * otherwise, if there are more lines to search, the timer is started to
+ * carry on from the next event loop.
+ */
 void
-window_copy_search_up(struct window_pane *wp, const char *searchstr)
+window_copy_search_run(struct window_pane *wp)
 {
 	struct window_copy_mode_data	*data = wp->modedata;
-	struct screen			*s = data->backing, ss;
-	struct screen_write_ctx		 ctx;
-	struct grid			*gd = s->grid, *sgd;
-	struct grid_cell	 	 gc;
-	size_t				 searchlen;
-	u_int				 i, last, fx, fy, px;
-	int				 utf8flag, n, wrapped;
+	struct window_copy_search	*ws = &data->search;
+	struct grid			*gd = data->backing->grid;
+	struct timeval			 tv;
+	u_int				 lines, py, first, last, px, nx, skip;
+	int				 found;
 
-	if (*searchstr == '\0')
+	/* Give up if the history has been cleared. */
+	if (gd->hsize + gd->sy != ws->total) {
+		window_copy_search_end(wp);
+		window_copy_redraw_lines(wp, 0, 1);
 		return;
-	utf8flag = options_get_number(&wp->window->options, "utf8");
-	searchlen = screen_write_strlen(utf8flag, "%s", searchstr);
+	}
 
-	screen_init(&ss, searchlen, 1, 0);
-	screen_write_start(&ctx, NULL, &ss);
-	memcpy(&gc, &grid_default_cell, sizeof gc);
-	screen_write_nputs(&ctx, -1, &gc, utf8flag, "%s", searchstr);
-	screen_write_stop(&ctx);
+	for (lines = 0; lines < WINDOW_COPY_SEARCH_LINES; lines++) {
+		if (ws->left == 0) {
+			window_copy_search_end(wp);
+			window_copy_redraw_lines(wp, 0, 1);
+			return;
+		}
 
-	fx = data->cx;
-	fy = gd->hsize - data->oy + data->cy;
+		/* Skip over history lines which the index says can't match. */
+		if (ws->indexed && ws->py < gd->hsize) {
+			if (grid_index_next(gd,
+			    &ws->query, ws->py, ws->up, &py) != 0)
+				skip = ws->up ? ws->py + 1 : gd->hsize - ws->py;
+			else
+				skip = ws->up ? ws->py - py : py - ws->py;
+			if (skip != 0) {
+				if (skip > ws->left)
+					skip = ws->left;
+				ws->left -= skip;
+				if (!ws->up)
+					ws->py = (ws->py + skip) % ws->total;
+				else if (skip > ws->py)
+					ws->py = ws->total - (skip - ws->py);
+				else
+					ws->py -= skip;
+				ws->partial = 0;
+				continue;
+			}
+		}
+		ws->left--;
+
+		py = ws->py;
+		if (ws->up) {
+			first = 0;
+			last = ws->partial ? ws->px : gd->sx;
+			found = window_copy_search_rl(
+			    wp, &px, &nx, py, first, last);
+			ws->py = py == 0 ? ws->total - 1 : py - 1;
+		} else {
+			first = ws->partial ? ws->px : 0;
+			last = gd->sx;
+			found = window_copy_search_lr(
+			    wp, &px, &nx, py, first, last);
+			ws->py = py == ws->total - 1 ? 0 : py + 1;
+		}
+		ws->partial = 0;
+		if (!found)
+			continue;
 
-	if (fx == 0) {
-		if (fy == 0)
+		ws->marked = 1;
+		ws->markx = px;
+		ws->marky = py;
+		ws->markn = nx;
+		window_copy_scroll_to(wp, px, py);
+
+		if (--ws->count == 0 || window_copy_search_position(wp) != 0) {
+			window_copy_search_end(wp);
+			window_copy_redraw_lines(wp, 0, 1);
 			return;
-		fx = gd->sx - 1;
-		fy--;
-	} else
-		fx--;
-	n = wrapped = 0;
-
-retry:
-	sgd = ss.grid;
-	for (i = fy + 1; i > 0; i--) {
-		last = screen_size_x(s);
-		if (i == fy + 1)
-			last = fx;
-		n = window_copy_search_rl(gd, sgd, &px, i - 1, 0, last);
-		if (n) {
-			window_copy_scroll_to(wp, px, i - 1);
-			break;
 		}
 	}
-	if (!n && !wrapped) {
-		fx = gd->sx - 1;
-		fy = gd->hsize + gd->sy - 1;
-		wrapped = 1;
-		goto retry;
-	}
 
-	screen_free(&ss);
+	window_copy_redraw_lines(wp, 0, 1);
+
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+	evtimer_add(&ws->timer, &tv);
 }
 
+/* ARGSUSED */
 void
-window_copy_search_down(struct window_pane *wp, const char *searchstr)
+window_copy_search_callback(unused int fd, unused short events, void *arg)
+{
+	struct window_pane	*wp = arg;
+
+	window_copy_search_run(wp);
+}
+
+/* Remove the highlight from the last match. */
+void
+window_copy_search_unmark(struct window_pane *wp)
 {
 	struct window_copy_mode_data	*data = wp->modedata;
-	struct screen			*s = data->backing, ss;
-	struct screen_write_ctx		 ctx;
-	struct grid			*gd = s->grid, *sgd;
-	struct grid_cell	 	 gc;
-	size_t				 searchlen;
-	u_int				 i, first, fx, fy, px;
-	int				 utf8flag, n, wrapped;
+	struct window_copy_search	*ws = &data->search;
+	u_int				 top;
 
-	if (*searchstr == '\0')
-		return;
-	utf8flag = options_get_number(&wp->window->options, "utf8");
-	searchlen = screen_write_strlen(utf8flag, "%s", searchstr);
+	ws->marked = 0;
 
-	screen_init(&ss, searchlen, 1, 0);
-	screen_write_start(&ctx, NULL, &ss);
-	memcpy(&gc, &grid_default_cell, sizeof gc);
-	screen_write_nputs(&ctx, -1, &gc, utf8flag, "%s", searchstr);
-	screen_write_stop(&ctx);
+	top = screen_hsize(data->backing) - data->oy;
+	if (ws->marky >= top && ws->marky < top + screen_size_y(&data->screen))
+		window_copy_redraw_lines(wp, ws->marky - top, 1);
+}
 
-	fx = data->cx;
-	fy = gd->hsize - data->oy + data->cy;
+/* Fill the search buffer with the bytes of a line. */
+void
+window_copy_search_fill(struct window_pane *wp, u_int py)
+{
+	struct window_copy_mode_data	*data = wp->modedata;
+	struct window_copy_search	*ws = &data->search;
 
-	if (fx == gd->sx - 1) {
-		if (fy == gd->hsize + gd->sy)
-			return;
-		fx = 0;
-		fy++;
-	} else
-		fx++;
-	n = wrapped = 0;
-
-retry:
-	sgd = ss.grid;
-	for (i = fy + 1; i < gd->hsize + gd->sy; i++) {
-		first = 0;
-		if (i == fy + 1)
-			first = fx;
-		n = window_copy_search_lr(gd, sgd, &px, i - 1, first, gd->sx);
-		if (n) {
-			window_copy_scroll_to(wp, px, i - 1);
+	ws->buflen = grid_string_line(data->backing->grid,
+	    py, &ws->buf, &ws->cols, &ws->bufsize);
+}
+
+/*
+ * Find the first match in the search buffer starting at or after a byte
+ * offset. Plain strings are found with memchr(3) on the first byte.
+ */
+int
+window_copy_search_next(
+    struct window_pane *wp, size_t off, size_t *start, size_t *end)
+{
+	struct window_copy_mode_data	*data = wp->modedata;
+	struct window_copy_search	*ws = &data->search;
+	regmatch_t			 rm;
+	const char			*ptr, *last;
+
+	if (off > ws->buflen)
+		return (0);
+
+	if (ws->regex) {
+		if (regexec(&ws->re, ws->buf + off, 1, &rm,
+		    off == 0 ? 0 : REG_NOTBOL) != 0)
+			return (0);
+		*start = off + rm.rm_so;
+		*end = off + rm.rm_eo;
+		return (1);
+	}
+
+	if (ws->len > ws->buflen - off)
+		return (0);
+	last = ws->buf + ws->buflen - ws->len + 1;
+	ptr = ws->buf + off;
+	while ((ptr = memchr(ptr, *ws->str, last - ptr)) != NULL) {
+		if (memcmp(ptr, ws->str, ws->len) == 0) {
+			*start = ptr - ws->buf;
+			*end = *start + ws->len;
+			return (1);
+		}
+		ptr++;
+	}
+	return (0);
+}
+
+/*
+ * Find the first match on a line starting from cell first up to last, and
+ * return its position and width in cells.
+ */
+int
+window_copy_search_lr(struct window_pane *wp,
+    u_int *ppx, u_int *pnx, u_int py, u_int first, u_int last)
+{
+	struct window_copy_mode_data	*data = wp->modedata;
+	struct window_copy_search	*ws = &data->search;
+	size_t				 off, start, end;
+
+	window_copy_search_fill(wp, py);
+
+	for (off = 0; off < ws->buflen; off++) {
+		if (ws->cols[off] >= first)
 			break;
+	}
+	if (!window_copy_search_next(wp, off, &start, &end))
+		return (0);
+	if (ws->cols[start] >= last)
+		return (0);
+	*ppx = ws->cols[start];
+	*pnx = ws->cols[end] - ws->cols[start];
+	return (1);
+}
+
+/*
+ * Find the last match on a line starting between cells first and last. Plain
+ * strings may overlap but regular expressions are matched from the end of the
+ * previous match, so the whole of the last match is found rather than its
+ * shortest suffix.
+ */
+int
+window_copy_search_rl(struct window_pane *wp,
+    u_int *ppx, u_int *pnx, u_int py, u_int first, u_int last)
+{
+	struct window_copy_mode_data	*data = wp->modedata;
+	struct window_copy_search	*ws = &data->search;
+	size_t				 off, start, end;
+	int				 found;
+
+	window_copy_search_fill(wp, py);
+
+	found = 0;
+	off = 0;
+	while (window_copy_search_next(wp, off, &start, &end)) {
+		if (ws->cols[start] > last)
+			break;
+		if (ws->cols[start] >= first) {
+			*ppx = ws->cols[start];
+			*pnx = ws->cols[end] - ws->cols[start];
+			found = 1;
 		}
+		if (ws->regex && end > start)
+			off = end;
+		else
+			off = start + 1;
 	}
-	if (!n && !wrapped) {
-		fx = 0;
-		fy = 0;
-		wrapped = 1;
-		goto retry;
+	return (found);
+}
+
+/* Start a search for the count'th match from the cursor. */
+void
+window_copy_search(
+    struct window_pane *wp, const char *searchstr, int up, u_int count)
+{
+	struct window_copy_mode_data	*data = wp->modedata;
+	struct window_copy_search	*ws = &data->search;
+	struct grid			*gd = data->backing->grid;
+
+	if (window_copy_search_start(wp, searchstr) != 0)
+		return;
+
+	ws->up = up;
+	ws->count = count;
+	ws->total = gd->hsize + gd->sy;
+	if (window_copy_search_position(wp) != 0) {
+		window_copy_search_end(wp);
+		return;
 	}
 
-	screen_free(&ss);
+	window_copy_search_run(wp);
+}
+
+void
+window_copy_search_up(
+    struct window_pane *wp, const char *searchstr, u_int count)
+{
+	window_copy_search(wp, searchstr, 1, count);
+}
+
+void
+window_copy_search_down(
+    struct window_pane *wp, const char *searchstr, u_int count)
+{
+	window_copy_search(wp, searchstr, 0, count);
 }
 
 void
@@ -1074,8 +1394,9 @@ window_copy_write_line(
 	struct screen			*s = &data->screen;
 	struct options			*oo = &wp->window->options;
 	struct grid_cell		 gc;
-	char				 hdr[32];
+	char				 hdr[64];
 	size_t	 			 last, xoff = 0, size = 0;
+	u_int				 done;
 
 	memcpy(&gc, &grid_default_cell, sizeof gc);
 	colour_set_fg(&gc, options_get_number(oo, "mode-fg"));
@@ -1083,7 +1404,22 @@ window_copy_write_line(
 	gc.attr |= options_get_number(oo, "mode-attr");
 
 	last = screen_size_y(s) - 1;
-	if (py == 0) {
+	if (py == 0 && data->errorstr != NULL) {
+		size = strlen(data->errorstr);
+		if (size > screen_size_x(s))
+			size = screen_size_x(s);
+		screen_write_cursormove(ctx, screen_size_x(s) - size, 0);
+		screen_write_nputs(ctx, size, &gc, 0, "%s", data->errorstr);
+	} else if (py == 0 && data->search.str != NULL) {
+		done = data->search.total + 1 - data->search.left;
+		size = xsnprintf(hdr, sizeof hdr, "(searching %u%%) [%u/%u]",
+		    (u_int) (done * 100ULL / (data->search.total + 1)),
+		    data->oy, screen_hsize(data->backing));
+		if (size > screen_size_x(s))
+			size = screen_size_x(s);
+		screen_write_cursormove(ctx, screen_size_x(s) - size, 0);
+		screen_write_puts(ctx, &gc, "%s", hdr);
+	} else if (py == 0) {
 		size = xsnprintf(hdr, sizeof hdr,
 		    "[%u/%u]", data->oy, screen_hsize(data->backing));
 		if (size > screen_size_x(s))
@@ -1108,6 +1444,10 @@ window_copy_write_line(
 	    (screen_hsize(data->backing) - data->oy) + py,
 	    screen_size_x(s) - size, 1);
 
+	if (data->search.marked)
+		window_copy_write_mark(
+		    wp, ctx, py, &gc, screen_size_x(s) - size);
+
 	if (py == data->cy && data->cx == screen_size_x(s)) {
 		memcpy(&gc, &grid_default_cell, sizeof gc);
 		screen_write_cursormove(ctx, screen_size_x(s) - 1, py);
@@ -1115,6 +1455,47 @@ window_copy_write_line(
 	}
 }
 
+/* Draw the last search match, if it is on this line, in the mode colours. */
+void
+window_copy_write_mark(struct window_pane *wp,
+    struct screen_write_ctx *ctx, u_int py, struct grid_cell *mgc, u_int sx)
+{
+	struct window_copy_mode_data	*data = wp->modedata;
+	struct window_copy_search	*ws = &data->search;
+	struct grid			*gd = data->backing->grid;
+	const struct grid_cell		*gc;
+	const struct grid_utf8		*gu;
+	struct grid_cell		 tmpgc;
+	struct utf8_data		 utf8data;
+	u_int				 xx;
+
+	if (ws->marky != (screen_hsize(data->backing) - data->oy) + py)
+		return;
+
+	screen_write_cursormove(ctx, ws->markx, py);
+	for (xx = ws->markx; xx < ws->markx + ws->markn && xx < sx; xx++) {
+		gc = grid_peek_cell(gd, xx, ws->marky);
+		if (gc->flags & GRID_FLAG_PADDING)
+			continue;
+		memcpy(&tmpgc, gc, sizeof tmpgc);
+		tmpgc.fg = mgc->fg;
+		tmpgc.bg = mgc->bg;
+		tmpgc.attr = mgc->attr;
+		tmpgc.flags &= ~(GRID_FLAG_FG256|GRID_FLAG_BG256);
+		tmpgc.flags |= mgc->flags & (GRID_FLAG_FG256|GRID_FLAG_BG256);
+
+		if (!(gc->flags & GRID_FLAG_UTF8)) {
+			screen_write_cell(ctx, &tmpgc, NULL);
+			continue;
+		}
+		gu = grid_peek_utf8(gd, xx, ws->marky);
+		utf8data.size = grid_utf8_copy(
+		    gu, utf8data.data, sizeof utf8data.data);
+		utf8data.width = gu->width;
+		screen_write_cell(ctx, &tmpgc, &utf8data);
+	}
+}
+
 void
 window_copy_write_lines(
     struct window_pane *wp, struct screen_write_ctx *ctx, u_int py, u_int ny)
@@ -1243,18 +1624,13 @@ window_copy_copy_selection(struct window_pane *wp)
 	struct screen			*s = &data->screen;
 	char				*buf;
 	size_t				 off;
-	u_int				 i, xx, yy, sx, sy, ex, ey, limit;
+	u_int				 xx, yy, sx, sy, ex, ey, limit;
 	u_int				 firstsx, lastex, restex, restsx;
 	int				 keys;
 
 	if (!s->sel.flag)
 		return;
 
-	buf = xmalloc(1);
-	off = 0;
-
-	*buf = '\0';
-
 	/*
 	 * The selection extends from selx,sely to (adjusted) cx,cy on
 	 * the base screen.
@@ -1324,25 +1700,19 @@ window_copy_copy_selection(struct window_pane *wp)
 		restsx = 0;
 	}
 
-	/* Copy the lines. */
-	if (sy == ey)
-		window_copy_copy_line(wp, &buf, &off, sy, firstsx, lastex);
-	else {
-		window_copy_copy_line(wp, &buf, &off, sy, firstsx, restex);
-		if (ey - sy > 1) {
-			for (i = sy + 1; i < ey; i++) {
-				window_copy_copy_line(
-				    wp, &buf, &off, i, restsx, restex);
-			}
-		}
-		window_copy_copy_line(wp, &buf, &off, ey, restsx, lastex);
-	}
+	/*
+	 * Work out the size first, so the buffer can be allocated once rather
+	 * than grown a character at a time, then copy the lines into it.
+	 */
+	off = window_copy_copy_lines(
+	    wp, NULL, sy, ey, firstsx, lastex, restsx, restex);
 
 	/* Don't bother if no data. */
-	if (off == 0) {
-		xfree(buf);
+	if (off == 0)
 		return;
-	}
+	buf = xmalloc(off);
+	window_copy_copy_lines(
+	    wp, buf, sy, ey, firstsx, lastex, restsx, restex);
 	off--;	/* remove final \n */
 
 	if (options_get_number(&global_options, "set-clipboard"))
@@ -1353,9 +1723,34 @@ window_copy_copy_selection(struct window_pane *wp)
 	paste_add(&global_buffers, buf, off, limit);
 }
 
-void
+/*
+ * Copy lines sy to ey of the selection into a buffer, or just count the bytes
+ * needed if buf is NULL.
+ */
+size_t
+window_copy_copy_lines(struct window_pane *wp, char *buf, u_int sy, u_int ey,
+    u_int firstsx, u_int lastex, u_int restsx, u_int restex)
+{
+	size_t	off;
+	u_int	i;
+
+	if (sy == ey)
+		return (window_copy_copy_line(wp, buf, sy, firstsx, lastex));
+
+	off = window_copy_copy_line(wp, buf, sy, firstsx, restex);
+	for (i = sy + 1; i < ey; i++) {
+		off += window_copy_copy_line(
+		    wp, buf == NULL ? NULL : buf + off, i, restsx, restex);
+	}
+	off += window_copy_copy_line(
+	    wp, buf == NULL ? NULL : buf + off, ey, restsx, lastex);
+	return (off);
+}
+
+/* Copy part of a line into a buffer (if not NULL), returning its size. */
+size_t
 window_copy_copy_line(struct window_pane *wp,
-    char **buf, size_t *off, u_int sy, u_int sx, u_int ex)
+    char *buf, u_int sy, u_int sx, u_int ex)
 {
 	struct window_copy_mode_data	*data = wp->modedata;
 	struct grid			*gd = data->backing->grid;
@@ -1363,10 +1758,10 @@ window_copy_copy_line(struct window_pane *wp,
 	const struct grid_utf8		*gu;
 	struct grid_line		*gl;
 	u_int				 i, xx, wrapped = 0;
-	size_t				 size;
+	size_t				 off, size;
 
 	if (sx > ex)
-		return;
+		return (0);
 
 	/*
 	 * Work out if the line was wrapped at the screen edge and all of it is
@@ -1386,28 +1781,31 @@ window_copy_copy_line(struct window_pane *wp,
 	if (sx > xx)
 		sx = xx;
 
-	if (sx < ex) {
-		for (i = sx; i < ex; i++) {
-			gc = grid_peek_cell(gd, i, sy);
-			if (gc->flags & GRID_FLAG_PADDING)
-				continue;
-			if (!(gc->flags & GRID_FLAG_UTF8)) {
-				*buf = xrealloc(*buf, 1, (*off) + 1);
-				(*buf)[(*off)++] = gc->data;
-			} else {
-				gu = grid_peek_utf8(gd, i, sy);
-				size = grid_utf8_size(gu);
-				*buf = xrealloc(*buf, 1, (*off) + size);
-				*off += grid_utf8_copy(gu, *buf + *off, size);
-			}
+	off = 0;
+	for (i = sx; i < ex; i++) {
+		gc = &gl->celldata[i];
+		if (gc->flags & GRID_FLAG_PADDING)
+			continue;
+		if (!(gc->flags & GRID_FLAG_UTF8)) {
+			if (buf != NULL)
+				buf[off] = gc->data;
+			off++;
+		} else {
+			gu = &gl->utf8data[i];
+			size = grid_utf8_size(gu);
+			if (buf != NULL)
+				grid_utf8_copy(gu, buf + off, size);
+			off += size;
 		}
 	}
 
 	/* Only add a newline if the line wasn't wrapped. */
 	if (!wrapped || ex != xx) {
-		*buf = xrealloc(*buf, 1, (*off) + 1);
-		(*buf)[(*off)++] = '\n';
+		if (buf != NULL)
+			buf[off] = '\n';
+		off++;
 	}
+	return (off);
 }
 
 void
@@ -44,10 +44,11 @@
  * Each pane also has a "virtual" screen (screen.c) which contains the current
  * state and is redisplayed when the window is reattached to a client.
  *
- * Windows are stored directly on a global array and wrapped in any number of
- * winlink structs to be linked onto local session RB trees. A reference count
- * is maintained and a window removed from the global list and destroyed when
- * it reaches zero.
+ * Windows are stored directly on a global list and wrapped in any number of
+ * winlink structs to be linked onto local session RB trees. Each window also
+ * keeps a list of its winlinks, so the sessions containing a window can be
+ * found without looking at every session. A reference count is maintained and
+ * a window removed from the global list and destroyed when it reaches zero.
  */
 
 /* Global window list. */
@@ -58,7 +59,10 @@ struct window_pane_tree all_window_panes;
 u_int	next_window_pane;
 
 void	window_pane_read_callback(struct bufferevent *, void *);
+void	window_pane_write_callback(struct bufferevent *, void *);
 void	window_pane_error_callback(struct bufferevent *, short, void *);
+void	window_pane_paste_fill(struct window_pane *);
+void	window_pane_paste_free(struct window_pane_paste *);
 
 RB_GENERATE(winlinks, winlink, entry, winlink_cmp);
 
@@ -76,17 +80,20 @@ window_pane_cmp(struct window_pane *wp1, struct window_pane *wp2)
 	return (wp1->id - wp2->id);
 }
 
+/* Find the lowest numbered winlink in a tree for a window. */
 struct winlink *
 winlink_find_by_window(struct winlinks *wwl, struct window *w)
 {
-	struct winlink	*wl;
+	struct winlink	*wl, *found;
 
-	RB_FOREACH(wl, winlinks, wwl) {
-		if (wl->window == w)
-			return (wl);
+	found = NULL;
+	TAILQ_FOREACH(wl, &w->winlinks, wentry) {
+		if (found != NULL && found->idx < wl->idx)
+			continue;
+		if (winlink_find_by_index(wwl, wl->idx) == wl)
+			found = wl;
 	}
-
-	return (NULL);
+	return (found);
 }
 
 struct winlink *
@@ -153,15 +160,33 @@ void
 winlink_set_window(struct winlink *wl, struct window *w)
 {
 	wl->window = w;
+	TAILQ_INSERT_TAIL(&w->winlinks, wl, wentry);
 	w->references++;
 }
 
+/* Exchange the windows of two winlinks. */
+void
+winlink_swap_windows(struct winlink *wl1, struct winlink *wl2)
+{
+	struct window	*w1 = wl1->window, *w2 = wl2->window;
+
+	TAILQ_REMOVE(&w1->winlinks, wl1, wentry);
+	TAILQ_REMOVE(&w2->winlinks, wl2, wentry);
+
+	wl1->window = w2;
+	TAILQ_INSERT_TAIL(&w2->winlinks, wl1, wentry);
+	wl2->window = w1;
+	TAILQ_INSERT_TAIL(&w1->winlinks, wl2, wentry);
+}
+
 void
 winlink_remove(struct winlinks *wwl, struct winlink *wl)
 {
 	struct window	*w = wl->window;
 
 	RB_REMOVE(winlinks, wwl, wl);
+	if (w != NULL)
+		TAILQ_REMOVE(&w->winlinks, wl, wentry);
 	if (wl->status_text != NULL)
 		xfree(wl->status_text);
 	xfree(wl);
@@ -235,21 +260,10 @@ winlink_stack_remove(struct winlink_stack *stack, struct winlink *wl)
 	}
 }
 
-int
-window_index(struct window *s, u_int *i)
-{
-	for (*i = 0; *i < ARRAY_LENGTH(&windows); (*i)++) {
-		if (s == ARRAY_ITEM(&windows, *i))
-			return (0);
-	}
-	return (-1);
-}
-
 struct window *
 window_create1(u_int sx, u_int sy)
 {
 	struct window	*w;
-	u_int		 i;
 
 	w = xcalloc(1, sizeof *w);
 	w->name = NULL;
@@ -265,18 +279,13 @@ window_create1(u_int sx, u_int sy)
 	w->sy = sy;
 
 	queue_window_name(w);
+	timer_set(&w->silence_event, server_window_silence_callback, w);
 
 	options_init(&w->options, &global_w_options);
 
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		if (ARRAY_ITEM(&windows, i) == NULL) {
-			ARRAY_SET(&windows, i, w);
-			break;
-		}
-	}
-	if (i == ARRAY_LENGTH(&windows))
-		ARRAY_ADD(&windows, w);
+	TAILQ_INSERT_TAIL(&windows, w, entry);
 	w->references = 0;
+	TAILQ_INIT(&w->winlinks);
 
 	return (w);
 }
@@ -308,22 +317,20 @@ window_create(const char *name, const char *cmd, const char *shell,
 void
 window_destroy(struct window *w)
 {
-	u_int	i;
-
-	if (window_index(w, &i) != 0)
-		fatalx("index not found");
-	ARRAY_SET(&windows, i, NULL);
-	while (!ARRAY_EMPTY(&windows) && ARRAY_LAST(&windows) == NULL)
-		ARRAY_TRUNC(&windows, 1);
+	TAILQ_REMOVE(&windows, w, entry);
 
 	if (w->layout_root != NULL)
 		layout_free(w);
 
-	evtimer_del(&w->name_timer);
+	timer_del(&w->silence_event);
 
 	options_free(&w->options);
 
+	/* Destroying panes may mark the window dirty or queue its name. */
 	window_destroy_panes(w);
+	if (w->flags & WINDOW_DIRTY)
+		TAILQ_REMOVE(&dirty_windows, w, dirty_entry);
+	unqueue_window_name(w);
 
 	if (w->name != NULL)
 		xfree(w->name);
@@ -349,8 +356,9 @@ window_set_active_pane(struct window *w, struct window_pane *wp)
 		if (w->active == NULL)
 			w->active = TAILQ_LAST(&w->panes, window_panes);
 		if (w->active == wp)
-			return;
+			break;
 	}
+	queue_window_name(w);
 }
 
 void
@@ -394,6 +402,7 @@ window_remove_pane(struct window *w, struct window_pane *wp)
 			if (w->active == NULL)
 				w->active = TAILQ_NEXT(wp, entry);
 		}
+		queue_window_name(w);
 	} else if (wp == w->last)
 		w->last = NULL;
 
@@ -546,6 +555,8 @@ window_pane_create(struct window *w, u_int sx, u_int sy, u_int hlimit)
 	wp->pipe_off = 0;
 	wp->pipe_event = NULL;
 
+	TAILQ_INIT(&wp->pastes);
+
 	wp->saved_grid = NULL;
 
 	screen_init(&wp->base, sx, sy, hlimit);
@@ -560,6 +571,7 @@ void
 window_pane_destroy(struct window_pane *wp)
 {
 	window_pane_reset_mode(wp);
+	window_pane_paste_clear(wp);
 
 	if (wp->fd != -1) {
 		close(wp->fd);
@@ -597,6 +609,7 @@ window_pane_spawn(struct window_pane *wp, const char *cmd, const char *shell,
 	const char	*ptr;
 	struct termios	 tio2;
 
+	window_pane_paste_clear(wp);
 	if (wp->fd != -1) {
 		close(wp->fd);
 		bufferevent_free(wp->event);
@@ -670,8 +683,9 @@ window_pane_spawn(struct window_pane *wp, const char *cmd, const char *shell,
 
 	setblocking(wp->fd, 0);
 
-	wp->event = bufferevent_new(wp->fd,
-	    window_pane_read_callback, NULL, window_pane_error_callback, wp);
+	wp->event = bufferevent_new(wp->fd, window_pane_read_callback,
+	    window_pane_write_callback, window_pane_error_callback, wp);
+	bufferevent_setwatermark(wp->event, EV_WRITE, PASTE_CHUNK_SIZE / 2, 0);
 	bufferevent_enable(wp->event, EV_READ|EV_WRITE);
 
 	return (0);
@@ -691,7 +705,13 @@ window_pane_read_callback(unused struct bufferevent *bufev, void *data)
 		bufferevent_write(wp->pipe_event, new_data, new_size);
 	}
 
+	if (new_size > 0) {
+		control_notify_output(wp,
+		    EVBUFFER_DATA(wp->event->input), new_size);
+	}
 	input_parse(wp);
+	if (wp->mode == &window_copy_mode)
+		window_copy_backing_changed(wp);
 
 	wp->pipe_off = EVBUFFER_LENGTH(wp->event->input);
 
@@ -702,6 +722,17 @@ window_pane_read_callback(unused struct bufferevent *bufev, void *data)
 	wp->window->flags |= WINDOW_SILENCE;
 	if (gettimeofday(&wp->window->silence_timer, NULL) != 0)
 		fatal("gettimeofday failed.");
+	server_window_silence_schedule(wp->window);
+}
+
+/* ARGSUSED */
+void
+window_pane_write_callback(unused struct bufferevent *bufev, void *data)
+{
+	struct window_pane	*wp = data;
+
+	if (!TAILQ_EMPTY(&wp->pastes))
+		window_pane_paste_fill(wp);
 }
 
 /* ARGSUSED */
@@ -773,6 +804,7 @@ window_pane_alternate_on(struct window_pane *wp, struct grid_cell *gc)
 	wp->base.grid->flags &= ~GRID_HISTORY;
 
 	wp->flags |= PANE_REDRAW;
+	server_window_dirty(wp->window);
 }
 
 /* Exit alternate screen mode and restore the copied grid. */
@@ -798,6 +830,7 @@ window_pane_alternate_off(struct window_pane *wp, struct grid_cell *gc)
 
 	/* Restore the grid, cursor position and cell. */
 	grid_duplicate_lines(s->grid, screen_hsize(s), wp->saved_grid, 0, sy);
+	screen_written(s, 0, sy);
 	s->cx = wp->saved_cx;
 	if (s->cx > screen_size_x(s) - 1)
 		s->cx = screen_size_x(s) - 1;
@@ -818,6 +851,7 @@ window_pane_alternate_off(struct window_pane *wp, struct grid_cell *gc)
 	wp->saved_grid = NULL;
 
 	wp->flags |= PANE_REDRAW;
+	server_window_dirty(wp->window);
 }
 
 int
@@ -832,6 +866,8 @@ window_pane_set_mode(struct window_pane *wp, const struct window_mode *mode)
 	if ((s = wp->mode->init(wp)) != NULL)
 		wp->screen = s;
 	wp->flags |= PANE_REDRAW;
+	server_window_dirty(wp->window);
+	queue_window_name(wp->window);
 	return (0);
 }
 
@@ -846,6 +882,8 @@ window_pane_reset_mode(struct window_pane *wp)
 
 	wp->screen = &wp->base;
 	wp->flags |= PANE_REDRAW;
+	server_window_dirty(wp->window);
+	queue_window_name(wp->window);
 }
 
 void
@@ -875,6 +913,124 @@ window_pane_key(struct window_pane *wp, struct session *sess, int key)
 	}
 }
 
+/*
+ * Queue a paste buffer to be written to a pane. The buffer is fed to the pty
+ * a chunk at a time as the application reads it, with each '\n' replaced by
+ * the separator and, if bracket is set, surrounded by bracketed paste markers.
+ */
+void
+window_pane_paste(struct window_pane *wp,
+    struct paste_buffer *pb, const char *sep, int bracket)
+{
+	struct window_pane_paste	*wpp;
+
+	if (wp->fd == -1)
+		return;
+
+	wpp = xcalloc(1, sizeof *wpp);
+	wpp->pb = pb;
+	pb->references++;
+
+	wpp->sep = xstrdup(sep);
+	wpp->seplen = strlen(sep);
+
+	if (bracket)
+		wpp->flags |= PANE_PASTE_BRACKET;
+
+	TAILQ_INSERT_TAIL(&wp->pastes, wpp, entry);
+	window_pane_paste_fill(wp);
+}
+
+/* Discard any pastes not yet written to a pane. */
+void
+window_pane_paste_clear(struct window_pane *wp)
+{
+	struct window_pane_paste	*wpp;
+
+	while ((wpp = TAILQ_FIRST(&wp->pastes)) != NULL) {
+		TAILQ_REMOVE(&wp->pastes, wpp, entry);
+		window_pane_paste_free(wpp);
+	}
+}
+
+/* Free a queued paste. */
+void
+window_pane_paste_free(struct window_pane_paste *wpp)
+{
+	paste_free(wpp->pb);
+	if (wpp->after != NULL)
+		evbuffer_free(wpp->after);
+	xfree(wpp->sep);
+	xfree(wpp);
+}
+
+/*
+ * Write input to a pane. If pastes are still being written, it is held until
+ * the last of them has finished so that it is not mixed into the paste.
+ */
+void
+window_pane_write(struct window_pane *wp, const void *data, size_t len)
+{
+	struct window_pane_paste	*wpp;
+
+	if ((wpp = TAILQ_LAST(&wp->pastes, window_pane_pastes)) == NULL) {
+		bufferevent_write(wp->event, data, len);
+		return;
+	}
+	if (wpp->after == NULL)
+		wpp->after = evbuffer_new();
+	evbuffer_add(wpp->after, data, len);
+}
+
+/* Top up the pane output buffer from the queued pastes. */
+void
+window_pane_paste_fill(struct window_pane *wp)
+{
+	struct window_pane_paste	*wpp;
+	struct paste_buffer		*pb;
+	const char			*data, *end, *lf;
+	size_t				 used, left;
+
+	while ((wpp = TAILQ_FIRST(&wp->pastes)) != NULL) {
+		used = EVBUFFER_LENGTH(wp->event->output);
+		if (used >= PASTE_CHUNK_SIZE)
+			return;
+		pb = wpp->pb;
+
+		if (!(wpp->flags & PANE_PASTE_STARTED)) {
+			if (wpp->flags & PANE_PASTE_BRACKET)
+				bufferevent_write(wp->event, "\033[200~", 6);
+			wpp->flags |= PANE_PASTE_STARTED;
+		}
+
+		data = pb->data + wpp->offset;
+		left = pb->size - wpp->offset;
+		if (left > PASTE_CHUNK_SIZE - used)
+			left = PASTE_CHUNK_SIZE - used;
+		end = data + left;
+
+		while ((lf = memchr(data, '\n', end - data)) != NULL) {
+			if (lf != data)
+				bufferevent_write(wp->event, data, lf - data);
+			bufferevent_write(wp->event, wpp->sep, wpp->seplen);
+			data = lf + 1;
+		}
+		if (end != data)
+			bufferevent_write(wp->event, data, end - data);
+
+		wpp->offset = end - pb->data;
+		if (wpp->offset != pb->size)
+			return;
+
+		if (wpp->flags & PANE_PASTE_BRACKET)
+			bufferevent_write(wp->event, "\033[201~", 6);
+		if (wpp->after != NULL)
+			bufferevent_write_buffer(wp->event, wpp->after);
+		TAILQ_REMOVE(&wp->pastes, wpp, entry);
+		window_pane_paste_free(wpp);
+	}
+}
+
 void
 window_pane_mouse(
     struct window_pane *wp, struct session *sess, struct mouse_event *m)
@@ -909,29 +1065,135 @@ window_pane_visible(struct window_pane *wp)
 	return (1);
 }
 
+/*
+ * Set up a search pattern. Patterns without any fnmatch(3) special
+ * characters are matched as plain substrings with strstr(3).
+ */
+void
+window_match_init(struct window_match *wm, const char *searchstr)
+{
+	if (strpbrk(searchstr, "*?[\\") == NULL) {
+		wm->pattern = xstrdup(searchstr);
+		wm->literal = 1;
+	} else {
+		xasprintf(&wm->pattern, "*%s*", searchstr);
+		wm->literal = 0;
+	}
+}
+
+/* Free a search pattern. */
+void
+window_match_free(struct window_match *wm)
+{
+	xfree(wm->pattern);
+}
+
+/* Does a string contain a search pattern? */
+int
+window_match_string(struct window_match *wm, const char *s)
+{
+	if (wm->literal)
+		return (strstr(s, wm->pattern) != NULL);
+	return (fnmatch(wm->pattern, s, 0) == 0);
+}
+
+/*
+ * Get the history index for a pane, creating it or freeing it if the
+ * history-index option has been changed.
+ */
+struct grid_index *
+window_pane_get_index(struct window_pane *wp)
+{
+	struct grid	*gd = wp->base.grid;
+
+	if (!options_get_number(&wp->window->options, "history-index")) {
+		if (gd->index != NULL)
+			grid_index_destroy(gd);
+		return (NULL);
+	}
+	if (gd->index == NULL)
+		grid_index_create(gd);
+	return (gd->index);
+}
+
+/* Search visible lines py to py + ny - 1 of a pane for a pattern. */
 char *
-window_pane_search(struct window_pane *wp, const char *searchstr, u_int *lineno)
+window_pane_search(struct window_pane *wp,
+    struct window_match *wm, u_int py, u_int ny, u_int *lineno)
 {
 	struct screen	*s = &wp->base;
-	char		*newsearchstr, *line, *msg;
+	char		*line;
 	u_int	 	 i;
 
-	msg = NULL;
-	xasprintf(&newsearchstr, "*%s*", searchstr);
+	if (py >= screen_size_y(s))
+		return (NULL);
+	if (ny > screen_size_y(s) - py)
+		ny = screen_size_y(s) - py;
 
-	for (i = 0; i < screen_size_y(s); i++) {
+	for (i = py; i < py + ny; i++) {
 		line = grid_view_string_cells(s->grid, 0, i, screen_size_x(s));
-		if (fnmatch(newsearchstr, line, 0) == 0) {
-			msg = line;
+		if (window_match_string(wm, line)) {
 			if (lineno != NULL)
 				*lineno = i;
+			return (line);
+		}
+		xfree(line);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Search the history of a pane for a pattern, from line *py - 1 towards the
+ * oldest line, looking at no more than *left lines. Only lines which may
+ * contain a plain string are looked at if the history is indexed. On return,
+ * *py is the line found or the line to continue from and *left is reduced by
+ * the number of lines looked at.
+ */
+char *
+window_pane_search_history(struct window_pane *wp,
+    struct window_match *wm, u_int *py, u_int *left)
+{
+	struct grid		*gd = wp->base.grid;
+	struct grid_index_query	 gq;
+	char			*line;
+	u_int			 next;
+	int			 indexed;
+
+	if (*py > gd->hsize)
+		*py = gd->hsize;
+
+	indexed = 0;
+	if (wm->literal && window_pane_get_index(wp) != NULL) {
+		if (grid_index_query_init(gd,
+		    &gq, wm->pattern, strlen(wm->pattern)) == 0)
+			indexed = 1;
+	}
+
+	line = NULL;
+	while (*py > 0 && *left > 0) {
+		if (indexed) {
+			if (grid_index_next(gd, &gq, *py - 1, 1, &next) != 0) {
+				*py = 0;
+				break;
+			}
+			*py = next + 1;
+		}
+		(*left)--;
+
+		line = grid_string_cells(gd, 0, *py - 1, gd->sx);
+		if (window_match_string(wm, line)) {
+			(*py)--;
 			break;
 		}
 		xfree(line);
+		line = NULL;
+		(*py)--;
 	}
 
-	xfree(newsearchstr);
-	return (msg);
+	if (indexed)
+		grid_index_query_free(&gq);
+	return (line);
 }
 
 /* Find the pane directly above another. */
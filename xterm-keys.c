@@ -34,13 +34,13 @@
  * 7 Alt + Ctrl
  * 8 Shift + Alt + Ctrl
  *
- * Rather than parsing them, just match against a table.
+ * Rather than parsing them, each is added to the tty key table (tty-keys.c)
+ * with every modifier.
  *
  * There are two forms for F1-F4 (\\033O_P or \\033[1;_P). We accept either but
  * always output the latter (it comes first in the table).
  */
 
-int	xterm_keys_match(const char *, const char *, size_t);
 int	xterm_keys_modifiers(const char *, const char *, size_t);
 
 struct xterm_keys_entry {
@@ -85,30 +85,6 @@ const struct xterm_keys_entry xterm_keys_table[] = {
 	{ KEYC_DC,	"\033[3;_~" },
 };
 
-/*
- * Match key against buffer, treating _ as a wildcard. Return -1 for no match,
- * 0 for match, 1 if the end of the buffer is reached (need more data).
- */
-int
-xterm_keys_match(const char *template, const char *buf, size_t len)
-{
-	size_t	pos;
-
-	if (len == 0)
-		return (0);
-
-	pos = 0;
-	do {
-		if (*template != '_' && buf[pos] != *template)
-			return (-1);
-	} while (pos++ != len && *++template != '\0');
-
-	if (*template != '\0')	/* partial */
-		return (1);
-
-	return (0);
-}
-
 /* Find modifiers based on template. */
 int
 xterm_keys_modifiers(const char *template, const char *buf, size_t len)
@@ -134,28 +110,31 @@ xterm_keys_modifiers(const char *template, const char *buf, size_t len)
 }
 
 /*
- * Lookup key from a buffer against the table. Returns 0 for found (and the
- * key), -1 for not found, 1 for partial match.
+ * Call a function for each key sequence in the table, with each modifier
+ * parameter from 1 (none) to 9 in place of the _.
  */
-int
-xterm_keys_find(const char *buf, size_t len, size_t *size, int *key)
+void
+xterm_keys_foreach(void (*fn)(const char *, int, void *), void *data)
 {
 	const struct xterm_keys_entry	*entry;
 	u_int				 i;
+	size_t				 len, idx;
+	char				*s;
+	int				 key;
 
 	for (i = 0; i < nitems(xterm_keys_table); i++) {
 		entry = &xterm_keys_table[i];
-		switch (xterm_keys_match(entry->template, buf, len)) {
-		case 0:
-			*size = strlen(entry->template);
-			*key = entry->key;
-			*key |= xterm_keys_modifiers(entry->template, buf, len);
-			return (0);
-		case 1:
-			return (1);
+
+		s = xstrdup(entry->template);
+		len = strlen(s);
+		idx = strcspn(s, "_");
+		for (s[idx] = '1'; s[idx] <= '9'; s[idx]++) {
+			key = entry->key;
+			key |= xterm_keys_modifiers(entry->template, s, len);
+			fn(s, key, data);
 		}
+		xfree(s);
 	}
-	return (-1);
 }
 
 /* Lookup a key number from the table. */